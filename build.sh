@@ -0,0 +1,51 @@
+#!/bin/sh
+# linux build, needs glfw3 (libglfw3-dev), opengl and zlib (zlib1g-dev)
+#  ./build.sh [gcc|llvm] [dbg|release] [proj]
+	
+	ROOT=$(cd "$(dirname "$0")" && pwd)/
+	SRC=${ROOT}src/
+	DEPS=${ROOT}deps/
+	GLAD=${DEPS}glad/
+	STB=${DEPS}stb/
+	
+	func=${1:-gcc}
+	
+	release=0
+	if [ "$2" = "release" ]; then release=1; fi
+	
+	proj=${3:-cedi}
+	
+	GLFW_FLAGS=$(pkg-config --cflags --libs glfw3 2>/dev/null || echo -lglfw)
+	LIBS="$GLFW_FLAGS -lGL -lz -lpthread -ldl"
+	
+	if [ $release = 0 ]; then
+		dbg="-O0 -g -DRZ_DBG=1"
+	else
+		dbg="-O3 -g -DRZ_DBG=0"
+	fi
+	
+	opt="$dbg -mmmx -msse -msse2"
+	
+	case $func in
+		gcc)
+			warn="-Wall -Wno-unused-variable -Wno-unused-but-set-variable -Wno-unused-function -Wno-tautological-compare"
+			
+			g++ -std=c++11 -m64 -DRZ_PLATF=2 -DRZ_ARCH=1 $opt $warn -I${SRC}include -I$GLAD -I$STB -o $ROOT$proj ${SRC}$proj.cpp $LIBS
+			;;
+		llvm)
+			warn="-Wall -Wno-unused-variable -Wno-unused-function -Wno-tautological-compare"
+			
+			clang++ -std=c++11 -m64 -DRZ_PLATF=2 -DRZ_ARCH=1 $opt $warn -I${SRC}include -I$GLAD -I$STB -o $ROOT$proj ${SRC}$proj.cpp $LIBS
+			;;
+		*)
+			echo "unknown compiler $func"
+			exit 1
+			;;
+	esac
+	
+	if [ $? = 0 ]; then
+		echo success.
+	else
+		echo fail.
+		exit 1
+	fi
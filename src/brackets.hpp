@@ -0,0 +1,322 @@
+
+// Bracket nesting index, finds the bracket matching any (), [] or {} without looking at the lines between the two
+//  every line gets summarized per bracket kind by its balance (opens -closes) and the lowest depth it reaches relative to its start,
+//  summaries combine like prefix sums, so lines are grouped into pages and a segment tree over the pages combines the page summaries,
+//  finding the line where the depth drops back to the depth before a bracket then descends the tree instead of scanning
+//  brackets in strings and comments count like all others, nothing gets parsed
+//  pages get rescanned lazily like snapshot pages, so the index costs nothing until the first lookup (which scans the whole buffer on all cores),
+//  unscanned tells how much the next lookup has to scan, so callers that can't wait for a whole huge file (the highlight in the layout) can avoid it
+
+static const u32 BRACKET_KINDS = 3;
+
+static s32 bracket_kind (utf32 c, s32* delta) { // -1 if c is not a bracket, delta +1 for open, -1 for close
+	switch (c) {
+		case U'(': *delta = +1; return 0;
+		case U')': *delta = -1; return 0;
+		case U'[': *delta = +1; return 1;
+		case U']': *delta = -1; return 1;
+		case U'{': *delta = +1; return 2;
+		case U'}': *delta = -1; return 2;
+		default: return -1;
+	}
+}
+
+struct Bracket_Sum { // of a line or a range of lines, zero is the summary of no brackets
+	s32		sum[BRACKET_KINDS]; // opens -closes
+	s32		low[BRACKET_KINDS]; // lowest depth after any prefix relative to the start, <= 0, the highest suffix sum is sum -low
+	
+	void add_char (utf32 c) {
+		s32 d;
+		s32 k = bracket_kind(c, &d);
+		if (k < 0) return;
+		sum[k] += d;
+		low[k] = min(low[k], sum[k]);
+	}
+	void add (Bracket_Sum cr r) { // r comes after this
+		for (u32 k=0; k<BRACKET_KINDS; ++k) {
+			low[k] = min(low[k], sum[k] +r.low[k]);
+			sum[k] += r.sum[k];
+		}
+	}
+	
+	// searching for an unmatched bracket, depth counts the brackets still waiting for their match,
+	//  forward from an open bracket opens add to it, backward from a close bracket closes do
+	bool reaches_zero (u32 k, s32 depth, bool forward) const { // depth drops to 0 somewhere inside this range
+		return forward ? depth +low[k] <= 0 : depth -(sum[k] -low[k]) <= 0;
+	}
+	s32 depth_after (u32 k, s32 depth, bool forward) const {
+		return forward ? depth +sum[k] : depth -sum[k];
+	}
+};
+
+struct Bracket_Index {
+	typedef buf_indx_t indx_t;
+	
+	static const u32 PAGE_LINES = 256; // pages get split once they grow past 2x this, and dropped when they become empty
+	
+	struct Page {
+		std::vector<Bracket_Sum>	lines;
+		Bracket_Sum					total;
+		u32							count; // lines in the buffer that belong to this page
+		bool						scanned; // false: lines changed since the last scan, lines and total are stale
+	};
+	std::vector<Page>			pages;
+	std::vector<u32>			dirty; // pages that need a rescan, can contain pages twice
+	bool						rebuild = true; // pages were added or removed, everything after the change moved, rebuild the whole tree
+	u32							unscanned = 0; // pages that the next update() has to scan
+	
+	// edits are usually close to the last one, so finding the page of a line walks from the last found page
+	u32							cache_page = 0;
+	indx_t						cache_first = 0;
+	
+	// segment tree over the pages, node i has the children 2i and 2i+1, the leaves start at leaf_base, the leaves past the last page stay zero
+	u32							leaf_base = 1;
+	std::vector<Bracket_Sum>	tree;
+	std::vector<indx_t>			tree_lines; // line count of the pages below each node
+	
+	void reset (indx_t line_count) { // all lines were replaced
+		pages.clear();
+		unscanned = 0;
+		for (indx_t l=0; l<line_count; l+=PAGE_LINES) {
+			append_page((u32)min((indx_t)PAGE_LINES, line_count -l));
+		}
+		cache_page = 0;
+		cache_first = 0;
+		rebuild = true;
+	}
+	void append_page (u32 count) {
+		pages.emplace_back();
+		pages.back().total = {};
+		pages.back().count = count;
+		pages.back().scanned = false;
+		unscanned += 1;
+	}
+	
+	u32 find_page (indx_t l) { // page containing line l, l == line count maps to the last page, sets cache_first to the first line of that page
+		dbg_assert(pages.size() > 0);
+		while (l < cache_first) {
+			cache_page -= 1;
+			cache_first -= pages[cache_page].count;
+		}
+		while (cache_page +1 < (u32)pages.size() && l >= cache_first +pages[cache_page].count) {
+			cache_first += pages[cache_page].count;
+			cache_page += 1;
+		}
+		return cache_page;
+	}
+	void page_changed (u32 i) {
+		if (pages[i].scanned) {
+			dirty.push_back(i);
+			unscanned += 1;
+		}
+		pages[i].scanned = false;
+	}
+	
+	// edits, called like the Snapshot_Builder hooks
+	void line_changed (indx_t l) {
+		page_changed(find_page(l));
+	}
+	void line_inserted (indx_t l) {
+		lines_inserted(l, 1);
+	}
+	void lines_inserted (indx_t l, indx_t count) { // new lines [l, l +count)
+		if (count <= 0) return;
+		
+		u32 i = find_page(l);
+		page_changed(i);
+		pages[i].count += (u32)count;
+		
+		if (pages[i].count > PAGE_LINES * 2) { // split right away, the tree needs a rebuild anyway once the page count changes
+			std::vector<Page> split;
+			u32 rest = pages[i].count -PAGE_LINES;
+			pages[i].count = PAGE_LINES;
+			for (; rest > PAGE_LINES * 2; rest -= PAGE_LINES) split.push_back(Page{ {}, {}, PAGE_LINES, false });
+			split.push_back(Page{ {}, {}, rest, false });
+			unscanned += (u32)split.size();
+			
+			pages.insert(pages.begin() +i +1, std::make_move_iterator(split.begin()), std::make_move_iterator(split.end()));
+			rebuild = true;
+		}
+	}
+	void line_erased (indx_t l) {
+		lines_erased(l, 1);
+	}
+	void lines_erased (indx_t l, indx_t count) { // lines [l, l +count)
+		if (count <= 0) return;
+		
+		u32 first = find_page(l);
+		indx_t offs = l -cache_first;
+		u32 end = first;
+		for (indx_t left=count; left>0; ++end) {
+			u32 n = (u32)min((indx_t)pages[end].count -offs, left);
+			page_changed(end);
+			pages[end].count -= n;
+			left -= n;
+			offs = 0;
+		}
+		
+		auto empty = std::remove_if(pages.begin() +first, pages.begin() +end, [] (Page cr p) { return p.count == 0; });
+		if (empty != pages.begin() +end) {
+			unscanned -= (u32)(pages.begin() +end -empty); // page_changed() counted them
+			pages.erase(empty, pages.begin() +end);
+			cache_page = 0; // cache_first of the pages after first would be wrong now
+			cache_first = 0;
+			rebuild = true;
+		}
+		dbg_assert(pages.size() > 0); // the buffer never has less than one line
+	}
+	void lines_appended (indx_t count) { // count new lines after the last one
+		if (count <= 0) return;
+		
+		u32 last = (u32)pages.size() -1;
+		u32 fill = (u32)min((indx_t)(PAGE_LINES -min(pages[last].count, PAGE_LINES)), count);
+		if (fill) {
+			page_changed(last);
+			pages[last].count += fill;
+		}
+		for (indx_t l=fill; l<count; l+=PAGE_LINES) {
+			append_page((u32)min((indx_t)PAGE_LINES, count -l));
+			rebuild = true;
+		}
+	}
+	
+	//
+	void update_node (u32 n) {
+		tree[n] = tree[n*2];
+		tree[n].add(tree[n*2 +1]);
+		tree_lines[n] = tree_lines[n*2] +tree_lines[n*2 +1];
+	}
+	indx_t page_first (u32 p) const { // first line of page p, from the tree
+		indx_t first = 0;
+		for (u32 n=leaf_base +p; n>1; n/=2) {
+			if (n & 1) first += tree_lines[n -1]; // right child, everything in the left sibling comes before
+		}
+		return first;
+	}
+	
+	// rescan the pages with edits and update the tree, only call from the thread that edits the buffer
+	//  scan_line(indx_t l, Bracket_Sum* s) calls s->add_char() for the chars of line l, it gets called from worker threads (while the editing thread waits)
+	template <typename SCAN_LINE>
+	void update (SCAN_LINE scan_line) {
+		if (!rebuild && dirty.size() == 0) return;
+		
+		std::vector<u32> todo;
+		std::vector<indx_t> todo_first;
+		
+		if (rebuild) {
+			leaf_base = 1;
+			while (leaf_base < (u32)pages.size()) leaf_base *= 2;
+			tree.assign(leaf_base * 2, Bracket_Sum{});
+			tree_lines.assign(leaf_base * 2, 0);
+			
+			indx_t first = 0;
+			for (u32 p=0; p<(u32)pages.size(); ++p) {
+				if (!pages[p].scanned) {
+					todo.push_back(p);
+					todo_first.push_back(first);
+				}
+				first += pages[p].count;
+			}
+		} else {
+			std::sort(dirty.begin(), dirty.end());
+			dirty.erase(std::unique(dirty.begin(), dirty.end()), dirty.end());
+			
+			// line counts first, so the first lines of the pages come out right
+			for (u32 p : dirty) {
+				tree_lines[leaf_base +p] = pages[p].count;
+				for (u32 n=(leaf_base +p)/2; n>=1; n/=2) tree_lines[n] = tree_lines[n*2] +tree_lines[n*2 +1];
+			}
+			for (u32 p : dirty) {
+				todo.push_back(p);
+				todo_first.push_back(page_first(p));
+			}
+		}
+		
+		g_jobs.parallel_for<u32>(0, (u32)todo.size(), 16, [&] (u32 b, u32 e) {
+			for (u32 i=b; i<e; ++i) {
+				auto& pg = pages[todo[i]];
+				pg.lines.assign(pg.count, Bracket_Sum{});
+				pg.total = {};
+				for (u32 j=0; j<pg.count; ++j) {
+					scan_line(todo_first[i] +j, &pg.lines[j]);
+					pg.total.add(pg.lines[j]);
+				}
+				pg.scanned = true;
+			}
+		});
+		
+		if (rebuild) {
+			for (u32 p=0; p<(u32)pages.size(); ++p) {
+				tree[leaf_base +p] = pages[p].total;
+				tree_lines[leaf_base +p] = pages[p].count;
+			}
+			for (u32 n=leaf_base -1; n>=1; --n) update_node(n);
+		} else {
+			for (u32 p : todo) {
+				tree[leaf_base +p] = pages[p].total;
+				for (u32 n=(leaf_base +p)/2; n>=1; n/=2) update_node(n);
+			}
+		}
+		dirty.clear();
+		rebuild = false;
+		unscanned = 0;
+	}
+	
+	// line with the match of a bracket in line l, after update()
+	//  depth: brackets of kind k still unmatched after scanning the rest of line l (> 0), gets the depth at the start (forward) or end (backward) of the found line
+	bool find_line (indx_t l, u32 k, bool forward, s32* depth, indx_t* found) const {
+		dbg_assert(!rebuild && dirty.size() == 0 && *depth > 0);
+		
+		// page of line l
+		u32 n = 1;
+		indx_t first = 0;
+		while (n < leaf_base) {
+			n *= 2;
+			if (l >= first +tree_lines[n]) {
+				first += tree_lines[n];
+				n += 1;
+			}
+		}
+		u32 p = n -leaf_base;
+		
+		auto search_page = [&] (u32 p, indx_t first, s32 from) -> bool { // lines of page p after (or before) line from of the page
+			auto& pg = pages[p];
+			s32 step = forward ? +1 : -1;
+			for (s32 j=from +step; j>=0 && j<(s32)pg.count; j+=step) {
+				if (pg.lines[j].reaches_zero(k, *depth, forward)) {
+					*found = first +j;
+					return true;
+				}
+				*depth = pg.lines[j].depth_after(k, *depth, forward);
+			}
+			return false;
+		};
+		if (search_page(p, first, (s32)(l -first))) return true;
+		
+		// up the tree until a sibling in search direction contains the match, then down to the first (or last) page that contains it
+		for (;; n/=2) {
+			if (n == 1) return false; // unmatched
+			u32 sib = forward ? n +1 : n -1;
+			if ((n & 1) == (forward ? 0u : 1u)) {
+				if (tree[sib].reaches_zero(k, *depth, forward)) {
+					n = sib;
+					break;
+				}
+				*depth = tree[sib].depth_after(k, *depth, forward);
+			}
+		}
+		while (n < leaf_base) {
+			u32 near = forward ? n*2 : n*2 +1;
+			if (tree[near].reaches_zero(k, *depth, forward)) {
+				n = near;
+			} else {
+				*depth = tree[near].depth_after(k, *depth, forward);
+				n = forward ? n*2 +1 : n*2;
+			}
+		}
+		p = n -leaf_base;
+		bool ok = search_page(p, page_first(p), forward ? -1 : (s32)pages[p].count);
+		dbg_assert(ok);
+		return ok;
+	}
+};
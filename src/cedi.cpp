@@ -1,12 +1,26 @@
 ﻿
-#define _USING_V110_SDK71_ 1
-#include "windows.h"
-
-#undef min
-#undef max
+#if RZ_PLATF == 1 // RZ_PLATF_GENERIC_WIN, lang_helpers.hpp is not included yet
+	#define _USING_V110_SDK71_ 1
+	#include "windows.h"
+	
+	#undef min
+	#undef max
+#endif
 
 #include <cstdio>
 
+// std headers need to be included before the gcc constexpr workaround below
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <new>
+#include <functional>
+#include <chrono>
+
 #include "lang_helpers.hpp"
 #include "math.hpp"
 
@@ -33,6 +47,29 @@ typedef fm4		m4;
 
 #include "gl.hpp"
 #include "util.hpp"
+#include "platform.hpp"
+#include "threading.hpp"
+#include "frame_arena.hpp"
+#include "jobs.hpp"
+
+// DBG: count the heap allocations of each thread, draw() asserts that idle frames make none
+//  idle frames are the ones that reuse the cached layout: redraws, cursor moves and smooth scrolling within the lines that are laid out
+//  frames that lay out lines are not checked, they can allocate (deque blocks, lines with more glyphs than any line before, decoding mapped pages)
+#define CHECK_IDLE_FRAME_ALLOCS 0
+
+#if CHECK_IDLE_FRAME_ALLOCS
+static thread_local u64 heap_allocs = 0;
+
+void* operator new (size_t size) {
+	++heap_allocs;
+	void* p = malloc(size ? size : 1);
+	if (!p) throw std::bad_alloc();
+	return p;
+}
+void operator delete (void* p) noexcept {
+	free(p);
+}
+#endif
 
 struct Options {
 	v3		col_background =				srgb(41,49,52);
@@ -43,6 +80,7 @@ struct Options {
 	v3		col_line_numbers_bar =			col_text * 0.2f;
 	v4		col_cursor =					v4(srgb(147,199,99), 0.8f);
 	v4		col_selection =					v4(1,1,1, 0.8f);
+	v3		col_bracket_match =				srgb(147,199,99); // bracket at the cursor and its match
 	
 	bool	draw_whitespace =				true;
 	
@@ -54,6 +92,12 @@ struct Options {
 	f32		tex_buffer_margin =				4;
 	
 	f32		overscroll_fraction =			1;//0.4f;
+	
+	s32		scroll_x_cols =					8; // columns per horizontal mouse wheel step
+	f32		zoom_step =						1.1f; // font zoom factor per CTRL+mouse wheel step
+	
+	bool	vsync =							true; // swap interval 1, limits drawing to once per display refresh, all input that arrives in the meantime gets coalesced into the next frame
+	bool	print_render_stats =			false; // damaged rects and gl calls of every drawn frame
 };
 
 static Options opt;
@@ -65,6 +109,10 @@ static f32 dt =				QNAN; // DBG: invalid values for debugging
 
 static f32 avg_dt =			1.0f/60; // to get reasonable dt for first frame of smooth scrolling
 
+static u32 frame_input_events =	0; // input events that were applied since the last frame was drawn (coalesced into one frame)
+
+static u32 vsync_gen =			0; // incremented every time the swap interval needs to be (re)set by the render thread
+
 static bool continuous_drawing = false;
 static void set_continuous_drawing (bool state);
 
@@ -75,15 +123,25 @@ static font::Font			g_font; // one font for everything for now
 
 typedef s64 buf_indx_t;
 
+#include "line_text.hpp"
+#include "line_pages.hpp"
+#include "folding.hpp"
+#include "brackets.hpp"
+#include "line_index.hpp"
+#include "journal.hpp"
+#include "gzip.hpp"
+#include "snapshot.hpp"
+
 struct Text_Buffer { // A buffer (think file) that the editor can display, it contains lines of text
 	
 	typedef buf_indx_t indx_t;
 	
 	struct Line {
-		std::vector<utf32>	text; // can contain U'\0' since we want to be able to handle files with null termintors in them
+		Line_Text	text; // can contain U'\0' since we want to be able to handle files with null termintors in them
 		
-		f32		pos_y;
-		std::vector<f32>	chars_x_px;
+		void release () {
+			text.release();
+		}
 		
 		u32 _count_newlines () {
 			auto len = text.size();
@@ -119,13 +177,58 @@ struct Text_Buffer { // A buffer (think file) that the editor can display, it co
 		}
 	};
 	
-	std::vector<Line> lines;
+	typedef Line_Pages<Line>::Page Line_Page;
+	
+	Text_Pool			text_pool; // all char data of lines, so dropping the buffer does not have to free every line
+	Line_Pages<Line>	lines; // lines of a mapped file stay in mapped pages until they are viewed or edited, only access lines through get_line()
+	
+	Line new_line () {
+		return Line{ Line_Text(&text_pool) };
+	}
+	Line& get_line (indx_t l) {
+		return lines.get(l, [this] (Line_Page* pg) { load_mapped_page(pg); });
+	}
+	void insert_line (indx_t l, Line&& ln) {
+		lines.insert(l, std::move(ln), [this] (Line_Page* pg) { load_mapped_page(pg); });
+	}
+	
+	Snapshot_Builder	snapshots; // every edit needs to tell it which lines changed
+	
+	std::shared_ptr<Buffer_Snapshot const> snapshot () { // for reading the contents on other threads while editing continues (find next)
+		lines.update_page_first();
+		return snapshots.get(lines.size(), [this] (Snapshot_Page* sp, indx_t first, u32 count) { // runs on worker threads
+			indx_t mapped_first;
+			if (lines.mapped_range(first, (indx_t)count, &mapped_first)) { // not viewed or edited, the page only needs to know where its lines are, the reader decodes them
+				find_mapped_groups(mapped_first, (indx_t)count, &sp->from, &sp->to);
+				sp->skip = (u32)(mapped_first % Line_Index::CHECKPOINT_LINES);
+				sp->count = count;
+				sp->source = mapped;
+				return;
+			}
+			
+			Snapshot_Builder::build_page(sp, first, count, [this] (indx_t l, std::vector<utf32>* out) {
+				indx_t i;
+				auto& pg = lines.page_of(l, &i);
+				if (pg.is_mapped()) { // next to edited lines, decode straight from the mapping, loading it into the buffer would not be thread safe
+					u64 len;
+					auto* str = get_mapped_lines(pg.mapped_first +i, 1, &len);
+					decode_utf8_lines(str, len, l, [&] (indx_t, utf32 c) { out->push_back(c); });
+				} else {
+					auto& ln = pg.lines[(uptr)i];
+					auto n = out->size();
+					out->resize(n +(uptr)ln.text.size());
+					ln.text.copy_to(out->data() +n);
+				}
+			});
+		});
+	}
 	
 	struct Cursor {
 		indx_t	l;
 		indx_t	c; // char index the cursor is on (cursor appears on the left edge of the char it's on)
 		
 		bool operator== (Cursor cr r) const { return l == r.l && c == r.c; }
+		bool operator< (Cursor cr r) const { return l < r.l || (l == r.l && c < r.c); }
 		NOINLINE bool operator!= (Cursor cr r) const { return l != r.l || c != r.c; }
 	};
 	
@@ -142,10 +245,31 @@ struct Text_Buffer { // A buffer (think file) that the editor can display, it co
 	iv2			sub_wnd_dim;
 	
 	// scrolling
-	indx_t		scroll;	// index of first line visible in text buffer window (from the top) (can overscroll, then this will be negative)
+	indx_t		scroll;	// index of first row visible in text buffer window (from the top) (can overscroll, then this will be negative), rows are the lines that are not folded away
+	
+	// scroll position between lines, a f32 line number would only be exact to a few lines in files with tens of millions of lines
+	struct Scroll_Pos {
+		indx_t	line;
+		f32		frac; // [0,1)
+		
+		f32 lines_to (indx_t target) const { // only exact for small distances, but it only drives the smooth scroll animation, which converges on the exact target
+			return (f32)(target -line) -frac;
+		}
+		f32 offset_from (indx_t anchor) const { // anchor is close to line, so this is exact
+			return (f32)(line -anchor) +frac;
+		}
+		void move (f32 lines) {
+			frac += lines;
+			f32 whole = floor(frac);
+			line += (indx_t)whole;
+			frac -= whole;
+		}
+	};
 	
 	// when smooth scrolling is enabled 'scroll' only defines the target to scroll to, 'smooth_scroll' is the actual scroll position
-	f32			smooth_scroll;
+	Scroll_Pos	smooth_scroll;
+	
+	indx_t		scroll_col; // first visible column (horizontal scrolling), columns instead of chars so that lines with tabs stay aligned
 	
 	void reset () {
 		cursor.l =			0;
@@ -155,14 +279,18 @@ struct Text_Buffer { // A buffer (think file) that the editor can display, it co
 		selecting =			SEL_NOT_SELECTING;
 		
 		scroll =			0;
-		smooth_scroll =		0;
+		smooth_scroll =		{ 0, 0 };
+		
+		scroll_col =		0;
 		
+		invalidate_layout();
 	}
 	
 	bool smooth_scroll_update () {
-		if ( abs((f32)scroll -smooth_scroll) < 0.01f ) {
+		f32 error = smooth_scroll.lines_to(scroll);
+		if ( abs(error) < 0.01f ) {
 			// already at destination
-			smooth_scroll = (f32)scroll;
+			smooth_scroll = { scroll, 0 };
 			set_continuous_drawing(false);
 			return false;
 		}
@@ -177,15 +305,14 @@ struct Text_Buffer { // A buffer (think file) that the editor can display, it co
 		f32 x0 = 5; // constant velocity
 		f32 x1 = 1.0f; // velocity proportional to distance
 		
-		f32 error = ((f32)scroll -smooth_scroll);
 		f32 vel = error * x1;
 		vel += error > 0 ? +x0 : -x0;
 		
-		smooth_scroll += vel * dt;
+		smooth_scroll.move(vel * dt);
 		
-		printf(">>> p %f v %f   dt %f ms\n", smooth_scroll, vel, dt * 1000);
+		printf(">>> p %lld+%f v %f   dt %f ms\n", (long long)smooth_scroll.line, smooth_scroll.frac, vel, dt * 1000);
 		#else
-		smooth_scroll = lerp(smooth_scroll, (f32)scroll, 0.4f);
+		smooth_scroll.move(error * 0.4f); // lerp towards scroll
 		#endif
 		
 		avg_dt = lerp(avg_dt, dt, 0.1f);
@@ -200,39 +327,64 @@ struct Text_Buffer { // A buffer (think file) that the editor can display, it co
 	struct Line_Range {
 		indx_t first, count;
 	};
+	Line_Range get_line_range_at (indx_t first) { // lines that intersect the window if it was scrolled to first (+ a fraction of a line)
+		indx_t last = first +get_max_visible_lines_count(); // +1 line, since while smooth scrolling the top and bottom line are only partially visible
+		
+		first = min(max(first, (indx_t)0), view_line_count() -1);
+		last = min(max(last, first), view_line_count() -1);
+		
+		return {first, last +1 -first};
+	}
 	Line_Range get_visible_line_range () {
-		indx_t first = clamp(scroll, (indx_t)0, (indx_t)(lines.size() -1));
+		return get_line_range_at(smooth_scroll.line);
+	}
+	
+	Col_Rules get_col_rules () {
+		return { opt.tab_spaces, opt.draw_whitespace };
+	}
+	u32 get_line_number_digits () { // max needed digits to diplay line numbers (byte offsets in hex in the hex view)
+		dbg_assert(lines.size() > 0);
 		
-		indx_t count = get_max_visible_lines_count();
-		if (scroll < 0) {
-			count += scroll;
-		} else if ((first +count) >= (indx_t)lines.size()) {
-			count -= (first +count) -(indx_t)lines.size();
+		u32 base = hex_view ? 16 : 10;
+		u32 digit_count = 0;
+		u64 num = hex_view ? (u64)(view_line_count() -1) * HEX_ROW_BYTES : (u64)lines.size() -1; // max needed number to diplay line numbers
+		while (num != 0) {
+			num /= base;
+			++digit_count;
 		}
+		return max(digit_count, (u32)1);
+	}
+	f32 get_text_x_px () { // x of first visible column, right of the line numbers
+		return g_font.border_left +opt.tex_buffer_margin +(f32)(get_line_number_digits() +1) * g_font.char_w;
+	}
+	indx_t get_max_visible_cols_count () {
+		indx_t count = (indx_t)floor( ((f32)sub_wnd_dim.x -get_text_x_px()) / g_font.char_w );
 		count = max(count, (indx_t)1);
-		
-		return {first, count};
+		return count;
 	}
 	
 	//
+	// the cursor skips over folded lines, moving to the previous or next row
 	void move_cursor_left () {
 		if (cursor.c > 0) {
-			cursor.c = min( cursor.c -1, lines[cursor.l].get_max_cursor_c() -1 ); // could happen when cursor is on newline and newline drawing gets disabled
+			cursor.c = min( cursor.c -1, get_max_cursor_c(cursor.l) -1 ); // could happen when cursor is on newline and newline drawing gets disabled
 		} else {
-			if (cursor.l > 0) {
-				--cursor.l;
-				cursor.c = lines[cursor.l].get_max_cursor_c();
+			indx_t row = row_of_line(cursor.l);
+			if (row > 0) {
+				cursor.l = line_of_row(row -1);
+				cursor.c = get_max_cursor_c(cursor.l);
 			}
 		}
 		
 		cursor_move_reset();
 	}
 	void move_cursor_right () {
-		if (cursor.c < lines[cursor.l].get_max_cursor_c()) {
+		if (cursor.c < get_max_cursor_c(cursor.l)) {
 			++cursor.c;
 		} else {
-			if (cursor.l < (indx_t)(lines.size() -1)) {
-				++cursor.l;
+			indx_t row = row_of_line(cursor.l);
+			if (row < view_line_count() -1) {
+				cursor.l = line_of_row(row +1);
 				cursor.c = 0;
 			}
 		}
@@ -241,45 +393,60 @@ struct Text_Buffer { // A buffer (think file) that the editor can display, it co
 	}
 	
 	void move_cursor_up () {
-		if (cursor.l > 0) {
-			--cursor.l;
-			cursor.c = min(lines[cursor.l].get_max_cursor_c(), cursor.c);
+		indx_t row = row_of_line(cursor.l);
+		if (row > 0) {
+			cursor.l = line_of_row(row -1);
+			cursor.c = min(get_max_cursor_c(cursor.l), cursor.c);
 		}
 		
 		cursor_move_reset();
 	}
 	void move_cursor_down () {
-		if (cursor.l < (indx_t)(lines.size() -1)) {
-			++cursor.l;
-			cursor.c = min(lines[cursor.l].get_max_cursor_c(), cursor.c);
+		indx_t row = row_of_line(cursor.l);
+		if (row < view_line_count() -1) {
+			cursor.l = line_of_row(row +1);
+			cursor.c = min(get_max_cursor_c(cursor.l), cursor.c);
 		}
 		
 		cursor_move_reset();
 	}
 	
 	void insert_char (utf32 c) {
-		lines[cursor.l].text.insert(lines[cursor.l].text.begin() +cursor.c, c);
+		if (hex_view) return; // read-only
+		journal.record(JOP_INSERT_CHAR, cursor.l, cursor.c, &c, sizeof(c));
+		get_line(cursor.l).text.insert(cursor.c, c);
+		snapshots.line_changed(cursor.l);
+		brackets.line_changed(cursor.l);
 		++cursor.c;
 		
+		invalidate_lines(cursor.l, cursor.l +1);
 		cursor_move_reset();
 	}
 	void insert_tab () {
 		insert_char(U'\t');
 	}
 	void insert_enter () {
-		// insert line after current line
-		auto& new_ = *lines.insert( lines.begin() +cursor.l +1, Line() );
-		auto& cur = lines[cursor.l];
+		if (hex_view) return;
+		journal.record(JOP_INSERT_ENTER, cursor.l, cursor.c);
 		
-		{ // Move chars after cursor to new line
-			auto b = cur.text.begin() +cursor.c;
-			auto e = cur.text.end();
-			
-			new_.text.insert(new_.text.begin(), b, e); // paste text after cursor into new line
-			cur.text.erase(b, e); // delete text after cursor from current line
-		}
+		auto& cur = get_line(cursor.l);
+		
+		// Move chars after cursor to new line
+		auto new_ = new_line();
+		new_.text = cur.text.split_off(cursor.c);
 		// terminte current line with newline
 		cur.text.push_back(U'\n');
+		
+		// insert line after current line
+		insert_line(cursor.l +1, std::move(new_));
+		snapshots.line_changed(cursor.l);
+		brackets.line_changed(cursor.l);
+		snapshots.line_inserted(cursor.l +1);
+		brackets.line_inserted(cursor.l +1);
+		folds.line_inserted(cursor.l +1);
+		// all following lines moved down
+		invalidate_lines(cursor.l, (indx_t)lines.size());
+		
 		// move cursor to beginning of new line
 		++cursor.l;
 		cursor.c = 0;
@@ -291,27 +458,43 @@ struct Text_Buffer { // A buffer (think file) that the editor can display, it co
 		// marge two lines by deleting newline
 		dbg_assert(newline_l < (indx_t)(lines.size() -1)); // cant merge last line with nothing
 		
-		auto& newl = lines[newline_l];
-		auto& next = lines[newline_l +1];
+		// merging text into or out of a fold would hide a visible line or show half of the fold, so open it
+		for (indx_t l : { newline_l, newline_l +1 }) reveal_line(l);
+		
+		auto& newl = get_line(newline_l);
+		auto& next = get_line(newline_l +1);
 		
 		// delete newline-line newline char
-		newl.text.erase(	newl.text.begin() +newl.get_newlineless_len(),
-							newl.text.begin() +newl.text.size());
+		newl.text.erase(newl.get_newlineless_len(), newl.text.size());
 		
 		// move cursor to end of newline-line (the place where we deleted the newline char)
 		if (cursor.l != newline_l) --cursor.l;
 		cursor.c = (indx_t)newl.text.size();
 		
-		// Merge line text
-		newl.text.insert(newl.text.end(), next.text.begin(), next.text.end());
+		// Merge line text, leaves next empty, so erasing it does not leak any storage
+		newl.text.append(std::move(next.text));
+		
+		lines.erase(newline_l +1, 1);
+		snapshots.line_changed(newline_l);
+		brackets.line_changed(newline_l);
+		snapshots.line_erased(newline_l +1);
+		brackets.line_erased(newline_l +1);
+		folds.line_erased(newline_l +1);
 		
-		lines.erase( lines.begin() +(newline_l +1), lines.begin() +(newline_l +2) );
+		// all following lines moved up, +1 since the last line moved out of the buffer
+		invalidate_lines(newline_l, (indx_t)lines.size() +1);
 	}
 	
 	void delete_prev () {
+		if (hex_view || delete_selection()) return;
+		journal.record(JOP_DELETE_PREV, cursor.l, cursor.c);
+		
 		if (cursor.c > 0) {
-			lines[cursor.l].text.erase( lines[cursor.l].text.begin() +(cursor.c -1) );
+			get_line(cursor.l).text.erase(cursor.c -1);
+			snapshots.line_changed(cursor.l);
+			brackets.line_changed(cursor.l);
 			--cursor.c;
+			invalidate_lines(cursor.l, cursor.l +1);
 		} else {
 			if (cursor.l > 0) {
 				// marge previous line with current line
@@ -322,8 +505,14 @@ struct Text_Buffer { // A buffer (think file) that the editor can display, it co
 		cursor_move_reset();
 	}
 	void delete_next () {
-		if (cursor.c < lines[cursor.l].get_newlineless_len()) {
-			lines[cursor.l].text.erase( lines[cursor.l].text.begin() +cursor.c );
+		if (hex_view || delete_selection()) return;
+		journal.record(JOP_DELETE_NEXT, cursor.l, cursor.c);
+		
+		if (cursor.c < get_line(cursor.l).get_newlineless_len()) {
+			get_line(cursor.l).text.erase(cursor.c);
+			snapshots.line_changed(cursor.l);
+			brackets.line_changed(cursor.l);
+			invalidate_lines(cursor.l, cursor.l +1);
 		} else {
 			if (cursor.l < (indx_t)(lines.size() -1)) {
 				// marge current line with next line
@@ -334,6 +523,87 @@ struct Text_Buffer { // A buffer (think file) that the editor can display, it co
 		cursor_move_reset();
 	}
 	
+	// range edits (paste, deleting a selection), these move whole lines at once instead of going char by char
+	//  cursors after the edit move along with the text
+	Cursor insert_text (Cursor pos, utf8 const* str, u64 len) { // returns the position after the inserted text
+		if (hex_view || len == 0) return pos;
+		dbg_assert(len <= (u64)(u32)-1); // journal records can't be bigger
+		journal.record(JOP_INSERT_TEXT, pos.l, pos.c, str, (u32)len);
+		
+		reveal_line(pos.l); // the new lines belong to the run of pos.l, inserted into a fold they and the cursor after them would be hidden
+		
+		auto tail = get_line(pos.l).text.split_off(pos.c);
+		indx_t added = insert_decoded(pos.l, str, len);
+		
+		Cursor end = { pos.l +added, 0 };
+		auto& last = get_line(end.l).text;
+		end.c = last.size();
+		last.append(std::move(tail));
+		
+		snapshots.line_changed(pos.l);
+		brackets.line_changed(pos.l);
+		snapshots.lines_inserted(pos.l +1, added);
+		brackets.lines_inserted(pos.l +1, added);
+		folds.lines_inserted(pos.l +1, added);
+		invalidate_lines(pos.l, added ? (indx_t)lines.size() : pos.l +1); // all following lines moved down
+		
+		for (auto* c : { &cursor, &select_cursor }) {
+			if (*c < pos) continue;
+			if (c->l == pos.l)	*c = { end.l, end.c +(c->c -pos.c) };
+			else				c->l += added;
+		}
+		return end;
+	}
+	void delete_range (Cursor a, Cursor b) { // chars [a, b)
+		if (hex_view || !(a < b)) return;
+		s64 end[2] = { b.l, b.c };
+		journal.record(JOP_DELETE_RANGE, a.l, a.c, end, sizeof(end));
+		
+		// joining text into or out of a fold would show half of it, like in newline_delete_merge_lines
+		if (folds.unfold_range(a.l, b.l +1)) invalidate_layout();
+		
+		indx_t erased = b.l -a.l;
+		auto& first = get_line(a.l).text;
+		if (erased == 0) {
+			first.erase(a.c, b.c);
+		} else {
+			first.erase(a.c, first.size());
+			first.append(get_line(b.l).text.split_off(b.c));
+			
+			// the lines in between get dropped without decoding them, if they are still mapped
+			lines.erase(a.l +1, erased);
+		}
+		
+		snapshots.line_changed(a.l);
+		brackets.line_changed(a.l);
+		snapshots.lines_erased(a.l +1, erased);
+		brackets.lines_erased(a.l +1, erased);
+		folds.lines_erased(a.l +1, erased);
+		invalidate_lines(a.l, erased ? (indx_t)lines.size() +erased : a.l +1); // all following lines moved up, the last ones out of the buffer
+		
+		for (auto* c : { &cursor, &select_cursor }) {
+			if (!(a < *c)) continue;
+			if (*c < b)				*c = a;
+			else if (c->l == b.l)	*c = { a.l, a.c +(c->c -b.c) };
+			else					c->l -= erased;
+		}
+	}
+	
+	bool delete_selection () { // false if nothing is selected
+		if (selecting == SEL_NOT_SELECTING || cursor == select_cursor) return false;
+		
+		if (cursor < select_cursor)	delete_range(cursor, select_cursor);
+		else						delete_range(select_cursor, cursor);
+		cursor_move_reset();
+		return true;
+	}
+	void paste (utf8 const* str, u64 len) { // replaces the selection
+		if (hex_view) return;
+		delete_selection();
+		insert_text(cursor, str, len);
+		cursor_move_reset();
+	}
+	
 	void start_select () {
 		dbg_assert(selecting == SEL_NOT_SELECTING || selecting == SEL_KEY_RELEASED);
 		select_cursor = cursor;
@@ -349,12 +619,89 @@ struct Text_Buffer { // A buffer (think file) that the editor can display, it co
 	}
 	
 	void open_file (cstr filename) {
-		std::vector<byte> tmp;
-		if (load_file_skip_bom(filename, &tmp, UTF8_BOM, arrlen(UTF8_BOM))) {
-			init_from_str((utf8*)&tmp[0], tmp.size());
-			printf("done.\n");
-		} else {
+		stop_follow();
+		stop_stream();
+		journal.close();
+		close_hex_view();
+		
+		Journal_Header stamp = {};
+		if (!get_file_stamp(filename, &stamp.file_size, &stamp.file_mtime)) {
 			printf("Could not open file '%s'!\n", filename);
+			return;
+		}
+		#if CEDI_GZIP
+		if (open_gzip(filename)) return;
+		#endif
+		
+		this->filename = filename;
+		file_size = stamp.file_size;
+		
+		if (is_binary_file(filename)) { // no decoding at all, so even huge files open instantly
+			init_from_str(nullptr, 0);
+			text_loaded = false;
+			open_hex_view();
+			return;
+		}
+		text_loaded = true;
+		
+		if (stamp.file_size >= MAP_MIN_SIZE && init_mapped(filename)) {
+			stamp.content_hash = Line_Index::content_hash(mapped_text, mapped_len);
+		} else {
+			std::vector<byte> tmp;
+			if (!load_file_skip_bom(filename, &tmp, UTF8_BOM, arrlen(UTF8_BOM))) {
+				printf("Could not open file '%s'!\n", filename);
+				return;
+			}
+			init_from_str((utf8*)&tmp[0], tmp.size());
+			stamp.content_hash = Line_Index::content_hash((utf8*)&tmp[0], tmp.size());
+		}
+		
+		open_journal(filename, stamp);
+		printf("done.\n");
+	}
+	
+	// crash journal
+	//  there is no saving yet, so the journal of a file keeps growing for as long as the file does not change on disk
+	Journal		journal;
+	
+	void open_journal (cstr filename, Journal_Header cr stamp) {
+		auto path = prints("%s.cedi-journal", filename);
+		
+		// journal is closed here, so replaying the edits does not record them again
+		u64 valid_size = 0;
+		u64 replayed = 0;
+		bool found = Journal::replay(path.c_str(), stamp, &valid_size, [&] (Journal_Record cr r, byte const* data) {
+			auto valid = [&] (s64 l, s64 c) { // can't be invalid unless the journal is corrupt
+				return l >= 0 && l < (indx_t)lines.size() && c >= 0 && c <= get_line(l).text.size();
+			};
+			if (!valid(r.l, r.c)) return;
+			
+			cursor = { r.l, r.c };
+			selecting = SEL_NOT_SELECTING;
+			switch (r.op) {
+				case JOP_INSERT_CHAR: {
+					utf32 c;
+					if (r.len != sizeof(c)) break;
+					memcpy(&c, data, sizeof(c));
+					insert_char(c);
+				} break;
+				case JOP_INSERT_ENTER:	insert_enter();							break;
+				case JOP_DELETE_PREV:	delete_prev();							break;
+				case JOP_DELETE_NEXT:	delete_next();							break;
+				case JOP_INSERT_TEXT:	insert_text(cursor, (utf8 const*)data, r.len);	break;
+				case JOP_DELETE_RANGE: {
+					s64 end[2];
+					if (r.len != sizeof(end)) break;
+					memcpy(end, data, sizeof(end));
+					if (valid(end[0], end[1])) delete_range(cursor, { end[0], end[1] });
+				} break;
+			}
+			++replayed;
+		});
+		if (replayed) printf("journal: recovered %llu edits from '%s'\n", (unsigned long long)replayed, path.c_str());
+		
+		if (!journal.open(path.c_str(), stamp, found ? valid_size : 0)) {
+			printf("journal: could not open '%s', edits will not survive a crash!\n", path.c_str());
 		}
 	}
 	
@@ -362,21 +709,40 @@ struct Text_Buffer { // A buffer (think file) that the editor can display, it co
 		indx_t ov = 1;
 		
 		auto count = get_max_visible_lines_count();
-		scroll = clamp(scroll, 0 -max(count -1 -ov, (indx_t)0), (indx_t)(lines.size() -ov));
+		scroll = clamp(scroll, 0 -max(count -1 -ov, (indx_t)0), view_line_count() -ov);
+		
+		scroll_col = max(scroll_col, (indx_t)0);
 	}
 	void constrain_scroll_to_cursor () {
 		auto count = get_max_visible_lines_count();
-		scroll = clamp(scroll, cursor.l -max(count -2, (indx_t)0), cursor.l);
+		indx_t row = row_of_line(cursor.l);
+		scroll = clamp(scroll, row -max(count -2, (indx_t)0), row);
+		
+		// column index makes this cheap even on multi-megabyte lines (only scans the chunk the cursor is in)
+		indx_t col = hex_view ?	hex_byte_col(cursor.c) :
+								get_line(cursor.l).text.get_col(cursor.c, get_col_rules());
+		indx_t cols = get_max_visible_cols_count();
+		scroll_col = min(max(scroll_col, col -max(cols -2, (indx_t)0)), col);
 	}
 	
 	void mouse_scroll (s32 diff) {
 		scroll -= diff;
 		constrain_scroll_to_buf();
 	}
+	void mouse_scroll_x (s32 diff) {
+		scroll_col -= diff * opt.scroll_x_cols;
+		constrain_scroll_to_buf();
+		invalidate_layout();
+	}
 	
 	void resize_sub_wnd (iv2 dim) {
 		sub_wnd_dim = dim;
 		constrain_scroll_to_cursor();
+		invalidate_layout();
+	}
+	void font_metrics_changed () { // zoom changed line height and char width
+		constrain_scroll_to_cursor();
+		invalidate_layout();
 	}
 	
 	indx_t get_overscroll_lines_count (indx_t max_visible_lines) {
@@ -402,251 +768,1497 @@ struct Text_Buffer { // A buffer (think file) that the editor can display, it co
 		//scroll = clamp(scroll, 0 -max(count -1 -ov, (indx_t)0), (indx_t)(lines.size() -ov));
 	}
 	
-	//
-	std::vector<VBO_Text::V>		vbo_char_vert_data;
+	// file loading
+	//  the bytes get split into chunks at line starts, each chunk gets decoded on a different core into its own Text_Pool,
+	//  a first pass counts the lines of every chunk, so each chunk knows its first line index and decodes directly into its place in the new pages
+	//  files of at least MAP_MIN_SIZE are not decoded at all, they stay mapped and each page of lines gets decoded when get_line() first touches it
+	static const u64 LOAD_CHUNK_MIN = 1024 * 1024;
+	static const u64 MAP_MIN_SIZE = 64 * 1024 * 1024;
 	
-	void init_from_str (utf8 const* str, u64 len) {
+	std::shared_ptr<Mapped_Source>	mapped; // null if nothing is mapped, snapshots with mapped pages share it
+	utf8 const*		mapped_text; // mapped->text, the mapped file without the bom, nullptr for a gzip file
+	u64				mapped_len;
+	Line_Index		line_index; // of mapped_text, or of the gzip output without the bom
+	u64				mapped_generation = 0; // changes whenever the mapped text gets replaced
+	
+	void drop_lines () { // lines have no destructors, all their chars are freed at once with the pool
+		cancel_search();
 		
 		lines.clear();
-		lines.push_back({});
+		text_pool.reset();
 		
-		auto* in = str;
-		while (in != (str +len)) {
-			utf32 c = utf8_to_utf32(&in);
-			
-			if (c == U'\n' && lines.size() % 2) lines.back().text.push_back( U'\r' );
-			
-			lines.back().text.push_back( c );
-			
-			if (c == U'\n' || c == U'\r') {
-				if (in != (str +len) && (*in == '\n' || *in == '\r') && (utf32)*in != c) {
-					lines.back().text.push_back( utf8_to_utf32(&in) );
-				}
+		mapped = nullptr; // gets unmapped once the snapshots of it are gone too
+		mapped_generation += 1;
+	}
+	
+	void append_decoded (utf8 const* str, u64 len) { // decode str into the buffer, continuing the last line, snapshots need to be told by the caller
+		insert_decoded((indx_t)lines.size() -1, str, len);
+	}
+	indx_t insert_decoded (indx_t first, utf8 const* str, u64 len) { // decode str into new lines after line first, continuing it, returns the number of new lines
+		auto& first_ln = get_line(first); // decode it if it is still mapped
+		
+		std::vector<u64> bounds; // a few chunks per thread, so that threads that finish early can steal the rest
+		split_line_chunks(str, len, max(len / ((g_jobs.worker_count +1) * 4) +1, LOAD_CHUNK_MIN), &bounds);
+		u32 chunks = (u32)bounds.size() -1;
+		
+		std::vector<indx_t> first_line(chunks +1);
+		std::vector< std::unique_ptr<Text_Pool> > pools(chunks);
+		
+		g_jobs.parallel_for<u32>(0, chunks, 1, [&] (u32 b, u32 e) {
+			for (u32 i=b; i<e; ++i)
+				first_line[i +1] = count_line_ends(str +bounds[i], bounds[i +1] -bounds[i]);
+		});
+		first_line[0] = first;
+		for (u32 i=0; i<chunks; ++i) first_line[i +1] += first_line[i];
+		
+		indx_t last = first_line[chunks]; // the line after the last newline, always exists, even if empty
+		indx_t added = last -first;
+		
+		// the new lines get decoded into their own pages, which get inserted at once, however many lines there are
+		auto new_pages = Line_Pages<Line>::make_pages(added, [this] () { return new_line(); });
+		auto line = [&] (indx_t l) -> Line& {
+			if (l == first) return first_ln;
+			indx_t i = l -first -1;
+			return new_pages[(uptr)(i / Line_Pages<Line>::PAGE_LINES)].lines[(uptr)(i % Line_Pages<Line>::PAGE_LINES)];
+		};
+		
+		g_jobs.parallel_for<u32>(0, chunks, 1, [&] (u32 b, u32 e) {
+			for (u32 i=b; i<e; ++i) {
+				pools[i] = std::unique_ptr<Text_Pool>(new Text_Pool);
+				decode_utf8_lines(str +bounds[i], bounds[i +1] -bounds[i], first_line[i], [&] (indx_t l, utf32 c) {
+					auto& t = line(l).text;
+					t.pool = pools[i].get();
+					t.push_back(c);
+				});
 				
-				lines.push_back({});
+				indx_t end = i == chunks -1 ? last +1 : first_line[i +1]; // the last chunk also has the line after the last newline
+				for (indx_t l=first_line[i]; l<end; ++l)
+					line(l).text.pool = &text_pool; // the memory gets spliced into text_pool below
 			}
-		}
+		});
 		
-		reset();
+		for (auto& p : pools) text_pool.splice(p.get());
+		
+		lines.insert_pages(first +1, std::move(new_pages), [this] (Line_Page* pg) { load_mapped_page(pg); });
+		return added;
 	}
 	
-	struct Cursor_Box {
-		v2 pos;
-		v2 dim;
-	};
-	Cursor_Box				cursor_box;
-	std::vector<Cursor_Box>	selection_boxes;
+	void init_from_str (utf8 const* str, u64 len) {
+		drop_lines();
+		
+		insert_line(0, new_line());
+		append_decoded(str, len);
+		
+		snapshots.reset((indx_t)lines.size());
+		brackets.reset((indx_t)lines.size());
+		folds.reset((indx_t)lines.size());
+		
+		reset();
+	}
 	
-	void generate_layout () {
+	bool init_mapped (cstr filename) {
+		drop_lines();
 		
-		vbo_char_vert_data.clear();
-		selection_boxes.clear();
+		u64 size, mtime;
+		auto m = std::make_shared<Mapped_Source>();
+		if (!get_file_stamp(filename, &size, &mtime) || !map_file(filename, &m->file)) return false;
+		mapped = m;
 		
-		auto vis_lines = get_visible_line_range();
+		mapped_text = (utf8 const*)mapped->file.data;
+		mapped_len = mapped->file.size;
+		if (mapped_len >= arrlen(UTF8_BOM) && memcmp(mapped_text, UTF8_BOM, arrlen(UTF8_BOM)) == 0) {
+			mapped_text += arrlen(UTF8_BOM);
+			mapped_len -= arrlen(UTF8_BOM);
+		}
+		mapped->text = mapped_text;
 		
-		Cursor* cursor_low;
-		Cursor* cursor_high;
-		{
-			if (		cursor.l == select_cursor.l ) {
-				if (cursor.c >= select_cursor.c) {
-					cursor_low =	&select_cursor;
-					cursor_high =	&cursor;
-				} else {
-					cursor_low =	&cursor;
-					cursor_high =	&select_cursor;
-				}
-			} else if (	cursor.l > select_cursor.l ) {
-				cursor_low =		&select_cursor;
-				cursor_high =		&cursor;
-			} else /* (	cursor.l < select_cursor.l */ {
-				cursor_low =		&cursor;
-				cursor_high =		&select_cursor;
-			}
-			
-			//printf(">> select %llu:%llu - %llu:%llu\n", cursor_low->l,cursor_low->c, cursor_high->l,cursor_high->c);
+		Line_Index::Sidecar_Header stamp = {};
+		stamp.file_size =		size;
+		stamp.file_mtime =		mtime;
+		stamp.content_hash =	Line_Index::content_hash(mapped_text, mapped_len);
+		
+		auto sidecar = prints("%s.cedi-index", filename);
+		
+		bool cached = line_index.load_sidecar(sidecar.c_str(), stamp, mapped_len); // builds it again if it is invalid
+		if (!cached) {
+			line_index.build(mapped_text, mapped_len);
+			line_index.save_sidecar(sidecar.c_str(), stamp);
 		}
+		printf("%s: %lld lines, line index %s\n", filename, (long long)line_index.line_count, cached ? "from sidecar" : "built");
 		
-		f32	pos_x_px;
-		//f32	pos_y_px = g_font.ascent_plus_gap +opt.tex_buffer_margin +(f32)((s64)g_font.line_height * -scroll);
-		f32	pos_y_px = g_font.ascent_plus_gap +opt.tex_buffer_margin +((f32)g_font.line_height * -smooth_scroll);
+		lines.append_mapped(0, line_index.line_count); // one page per PAGE_LINES lines, nothing gets decoded yet
 		
-		for (indx_t line_i=0; line_i<(indx_t)lines.size(); ++line_i) {
-			auto& l = lines[line_i];
-			
-			pos_x_px = g_font.border_left +opt.tex_buffer_margin;
-			
-			auto emit_glyph = [&] (utf32 c, v3 col) {
-				
-				if (line_i == vis_lines.first)
-					col *= v3(1,0,0);
-				if (line_i == (vis_lines.first +vis_lines.count -1))
-					col *= v3(0,0,1);
-				
-				pos_x_px = g_font.emit_glyph(&vbo_char_vert_data, pos_x_px,pos_y_px, c, v4(col,1));
-			};
-			
-			{ // emit line numbers
-				v3 col = opt.col_line_numbers;
-				
-				//if (selecting && line_i >= cursor_low->l && line_i <= cursor_high->l)
-				//	col = opt.col_selection.xyz();
-				if (line_i == cursor.l)
-					col = opt.col_cursor.xyz();
-				
-				u32 digit_count = 0; // max needed digits to diplay line numbers
-				{
-					dbg_assert(lines.size() > 0);
-					indx_t num = (indx_t)lines.size() -1; // max needed number to diplay line numbers
-					while (num != 0) {
-						num /= 10;
-						++digit_count;
-					}
-					digit_count = max(digit_count, (u32)1);
-				}
-				
-				u32 num = line_i;
-				utf32 buf[32];
-				u32 num_len = 0;
-				for (; num_len<digit_count; ++num_len) {
-					if (num_len > 0 && num == 0) break;
-					buf[num_len] = num % 10;
-					num /= 10;
-				}
-				num_len = max(num_len, (u32)1);
-				
-				for (u32 i=digit_count; i!=0;) { --i;
-					emit_glyph(i < num_len ? U'0' +buf[i] : U' ', col);
-				}
-				emit_glyph(U'|', opt.col_line_numbers_bar);
-			}
-			
-			l.pos_y = pos_y_px;
-			l.chars_x_px.clear();
-			
-			indx_t tab_char_i=0;
-			
-			auto emit_char = [&] (utf32 c, v3 col) {
-				emit_glyph(c, col);
-			};
-			auto emit_escaped_char = [&] (utf32 c) {
-				auto tmp = pos_x_px;
-				emit_glyph(U'\\', opt.col_draw_whitespace);
-				pos_x_px = lerp(tmp, pos_x_px, 0.6f); // squash \ and c closer together to make it seem like 1 glyph
-				
-				emit_glyph(c, opt.col_draw_whitespace);
-				++tab_char_i;
-			};
-			auto emit_tab = [&] () {
-				indx_t spaces_needed = opt.tab_spaces -(tab_char_i % opt.tab_spaces);
-				
-				for (indx_t j=0; j<spaces_needed; ++j) {
-					auto c = U' ';
-					if (opt.draw_whitespace) {
-						c = j<spaces_needed-1 ? U'—' : U'→';
-					}
-					
-					emit_glyph(c, opt.col_draw_whitespace);
-					
-					++tab_char_i;
-				}
+		snapshots.reset(lines.size());
+		brackets.reset(lines.size());
+		folds.reset(lines.size());
+		
+		reset();
+		return true;
+	}
+	void load_mapped_page (Line_Page* pg) { // decodes the whole page, the lines around a viewed line usually get viewed too
+		u64 len;
+		auto* str = get_mapped_lines(pg->mapped_first, pg->count, &len);
+		
+		pg->lines.reserve(pg->count);
+		for (u32 i=0; i<pg->count; ++i) pg->lines.push_back(new_line());
+		decode_utf8_lines(str, len, 0, [&] (indx_t i, utf32 c) { pg->lines[(uptr)i].text.push_back(c); });
+		pg->mapped_first = -1;
+	}
+	
+	void find_mapped_groups (indx_t first, indx_t n, u64* from, u64* to) const { // bytes of the checkpoint groups the mapped lines [first, first +n) are in, from the one of first up to the one of the line after them
+		static const indx_t CHECKPOINT_LINES = Line_Index::CHECKPOINT_LINES;
+		auto& cps = line_index.checkpoints;
+		
+		uptr end_group = (uptr)((first +n +CHECKPOINT_LINES -1) / CHECKPOINT_LINES);
+		*from = cps[(uptr)(first / CHECKPOINT_LINES)];
+		*to = end_group < cps.size() ? cps[end_group] : line_index.text_len;
+	}
+	
+	// bytes of the mapped lines [first, first +n) including their newlines, can be called from any thread
+	//  a gzip file gets inflated into a buffer of the calling thread, it holds the checkpoint groups of the last call,
+	//  so going through the lines one by one (snapshots, bracket sums) only copies every group out of the span cache once
+	utf8 const* get_mapped_lines (indx_t first, indx_t n, u64* len) const {
+		u64 from, to;
+		find_mapped_groups(first, n, &from, &to);
+		
+		utf8 const* str;
+		#if CEDI_GZIP
+		if (mapped->gz) {
+			struct Inflated {
+				Text_Buffer const*	buf;
+				u64					generation;
+				u64					from, to;
+				std::vector<byte>	bytes;
 			};
+			static thread_local Inflated inflated = {};
 			
-			for (indx_t char_i=0; char_i<(indx_t)l.text.size(); ++char_i) {
-				l.chars_x_px.push_back(pos_x_px);
-				
-				utf32 c = l.text[ char_i ];
-				switch (c) {
-					case U'\t': {
-						emit_tab();
-					} break;
-					
-					case U'\n': {
-						if (opt.draw_whitespace) emit_escaped_char(U'n');
-					} break;
-					case U'\r': {
-						if (opt.draw_whitespace) emit_escaped_char(U'r');
-					} break;
-					case U'\0': {
-						emit_escaped_char(U'0');
-					} break;
-					
-					case U' ': {
-						if (opt.draw_whitespace) {
-							emit_char(U'·', opt.col_draw_whitespace);
-						} else {
-							emit_char(c, opt.col_text);
-						}
-						
-						++tab_char_i;
-					} break;
-					
-					default: {
-						emit_char(c, opt.col_text);
-						++tab_char_i;
-					} break;
-				}
-			}
-			
-			l.chars_x_px.push_back(pos_x_px); // push char pos for imaginary last character, to be able to determine width of last char on line
-			
-			if (selecting && line_i >= cursor_low->l && line_i <= cursor_high->l) { // emit selection boxes
-				u32 c = 0;
-				u32 max_c = l.chars_x_px.size() -1;
-				
-				if (line_i == cursor_low->l)		c = cursor_low->c;
-				if (line_i == cursor_high->l)	max_c = cursor_high->c;
-				
-				f32 x = l.chars_x_px[c];
-				f32 w = l.chars_x_px[min((size_t)max_c, l.chars_x_px.size() -1)] -x;
-				
-				if (!opt.draw_whitespace && max_c >= l.get_newlineless_len() && line_i != (lines.size() -1)) {
-					w += opt.min_cursor_w_px;
-				}
-				
-				Cursor_Box	s = {	v2(x -g_font.border_left, pos_y_px -g_font.line_height +g_font.descent_plus_gap),
-									v2(w, g_font.line_height) };
-				
-				selection_boxes.push_back(s);
+			if (inflated.buf != this || inflated.generation != mapped_generation || inflated.from != from || inflated.to != to) {
+				inflated.buf = this;
+				inflated.generation = mapped_generation;
+				inflated.from = from;
+				inflated.to = to;
+				mapped->read(from, to, &inflated.bytes);
 			}
-			
-			pos_y_px += g_font.line_height;
-			
+			str = (utf8 const*)inflated.bytes.data();
+		} else
+		#endif
+		{
+			str = mapped_text +from;
 		}
 		
-		{ // emit cursor box
-			f32 x = lines[cursor.l].chars_x_px[ cursor.c ];
-			
-			f32 w = 0;
-			if (cursor.c < (indx_t)(lines[cursor.l].chars_x_px.size() -1)) {
-				w = lines[cursor.l].chars_x_px[ cursor.c +1 ] -x; // could be imaginary last character
-			}
-			// w might end up zero because either the final few chars on the line are invisible (newline because draw_whitespace is off) or is not a character (end of file)
-			
-			w *= opt.min_cursor_w_percent_of_char;
-			
-			w = max(w, opt.min_cursor_w_px);
-			
-			if (selecting && *cursor_high != *cursor_low) {
-				w = opt.min_cursor_w_px;
+		u64 b = skip_lines(str, to -from, 0, first % Line_Index::CHECKPOINT_LINES);
+		u64 e = skip_lines(str, to -from, b, n);
+		*len = e -b;
+		return str +b;
+	}
+	
+	// appending to the end of the buffer (follow mode, streaming from a pipe)
+	//  only the new bytes get decoded (with append_decoded(), on all cores if a lot arrived at once), a line that is still being written just grows,
+	//  the only bytes that get held back are a utf8 sequence that was cut off, so at most 3 bytes wait for the next append
+	u64 append_bytes (utf8 const* str, u64 len, bool final) { // returns how many bytes were appended, the rest has to be passed again in front of the next bytes, final: no more bytes follow, append all of them
+		if (!final) len = complete_utf8_len(str, len); // the rest of the char was not written yet
+		if (len == 0) return 0;
+		
+		bool cursor_at_end = cursor.l == lines.size() -1;
+		indx_t first = lines.size() -1;
+		
+		// a newline pair split between two appends, the first char already ended a line, the second one belongs to that line too
+		u64 skip = 0;
+		if (first > 0 && get_line(first).text.size() == 0 && (str[0] == '\n' || str[0] == '\r')) {
+			auto& prev = get_line(first -1);
+			if (prev._count_newlines() == 1 && prev.text.back() != (utf32)str[0]) {
+				prev.text.push_back((utf32)str[0]);
+				snapshots.line_changed(first -1);
+				brackets.line_changed(first -1);
+				invalidate_lines(first -1, first);
+				skip = 1;
 			}
-			
-			cursor_box = {	v2(x -g_font.border_left, lines[cursor.l].pos_y -g_font.line_height +g_font.descent_plus_gap),
-							v2(w, g_font.line_height) };
+		}
+		indx_t added = insert_decoded(first, str +skip, len -skip);
+		
+		appended(first, added, cursor_at_end);
+		return len;
+	}
+	void appended (indx_t first, indx_t added, bool cursor_at_end) { // line first got chars appended, and added lines after it
+		snapshots.line_changed(first);
+		brackets.line_changed(first);
+		snapshots.lines_appended(added);
+		brackets.lines_appended(added);
+		folds.lines_appended(added);
+		invalidate_lines(first, lines.size());
+		
+		if (cursor_at_end) { // tail -f behavior, stays at the end until the user moves the cursor up
+			cursor = { lines.size() -1, get_line(lines.size() -1).get_max_cursor_c() };
+			reveal_line(cursor.l);
+			constrain_scroll_to_cursor();
 		}
 	}
 	
-};
-
-Text_Buffer g_buf; // init to zero/null
-
-// input events
-static void move_cursor_left () {		g_buf.move_cursor_left();	}
-static void move_cursor_right () {		g_buf.move_cursor_right();	}
-static void move_cursor_up () {			g_buf.move_cursor_up();		}
-static void move_cursor_down () {		g_buf.move_cursor_down();	}
-static void scroll_page_up () {			g_buf.scroll_page_up();		}
-static void scroll_page_down () {		g_buf.scroll_page_down();	}
-static void mouse_scroll (s32 diff) {	g_buf.mouse_scroll(diff);	}
+	// follow mode (ALT+F), for log files that keep growing
+	//  a thread sleeps until the file gets written to, then the main thread maps the file again and extends the line index over only the appended bytes,
+	//  the new lines get appended as mapped pages, so they only get decoded once they are viewed, like the lines of a file that was opened mapped
+	std::string			filename; // of the open file, empty when streaming
+	u64					file_size; // when it was loaded
+	
+	bool				following = false;
+	File_Watch			follow_watch;
+	std::thread			follow_thread;
+	std::atomic<bool>	follow_changed {false};
+	std::atomic<bool>	follow_quit {false};
+	
+	u64					follow_offset; // bytes of the file before this are in the buffer
+	
+	void start_follow () {
+		if (following || filename.empty() || hex_view) return;
+		if (!watch_file(filename.c_str(), &follow_watch)) {
+			printf("follow: could not watch '%s'!\n", filename.c_str());
+			return;
+		}
+		journal.close(); // the journal only applies to the file contents it was started on, which keep changing now
+		
+		follow_offset = file_size;
+		
+		following = true;
+		follow_quit = false;
+		follow_changed = true; // pick up whatever was appended since the file was loaded
+		follow_thread = std::thread([this] () {
+			while (!follow_quit) {
+				if (wait_file_changed(&follow_watch, 100)) {
+					follow_changed = true;
+					glfwPostEmptyEvent(); // wake up the main loop
+				}
+			}
+		});
+		printf("follow: '%s'\n", filename.c_str());
+	}
+	void stop_follow () {
+		if (!following) return;
+		
+		follow_quit = true;
+		follow_thread.join();
+		unwatch_file(&follow_watch);
+		following = false;
+	}
+	void toggle_follow () {
+		if (following) {
+			stop_follow();
+			printf("follow: off\n");
+		} else {
+			start_follow();
+		}
+	}
+	
+	bool follow_update () { // call from the main loop, returns if lines were appended
+		if (!following || !follow_changed.exchange(false)) return false;
+		
+		u64 size, mtime;
+		if (!get_file_stamp(filename.c_str(), &size, &mtime)) return false; // deleted or moved away (log rotation), keep showing what we have
+		
+		if (size < follow_offset) { // truncated or rewritten, start over
+			printf("follow: '%s' shrank, reloading\n", filename.c_str());
+			auto path = filename;
+			open_file(path.c_str());
+			start_follow();
+			return true;
+		}
+		
+		if (size == follow_offset) return false;
+		
+		// the last two lines get the new bytes, decode them while the mapping still ends where the buffer does, so nothing ends up in them twice
+		indx_t last = lines.size() -1;
+		get_line(last);
+		if (last > 0) get_line(last -1);
+		
+		auto m = std::make_shared<Mapped_Source>(); // the old mapping stays until the snapshots that still read from it are gone
+		if (!map_file(filename.c_str(), &m->file)) return false;
+		bool was_mapped = mapped != nullptr;
+		mapped = m;
+		
+		u64 bom = mapped->file.size >= arrlen(UTF8_BOM) && memcmp(mapped->file.data, UTF8_BOM, arrlen(UTF8_BOM)) == 0 ? arrlen(UTF8_BOM) : 0;
+		mapped_text = (utf8 const*)mapped->file.data +bom;
+		mapped->text = mapped_text;
+		if (!was_mapped) { // small enough to be decoded when it was loaded, index what the buffer has
+			line_index.build(mapped_text, max(follow_offset, bom) -bom);
+		}
+		u64 old_len = line_index.text_len;
+		indx_t old_count = line_index.line_count;
+		
+		mapped_len = max(complete_utf8_len(mapped_text, mapped->file.size -bom), old_len); // a char that is still being written waits for the next change
+		line_index.extend(mapped_text +old_len, mapped_len -old_len);
+		follow_offset = bom +mapped_len;
+		
+		bool cursor_at_end = cursor.l == last;
+		
+		u64 b, e;
+		line_index.find_line(mapped_text, mapped_len, old_count -1, &b, &e);
+		if (b > old_len && last > 0) { // the second char of a newline pair that the old end split, it ends the line before
+			get_line(last -1).text.push_back((utf32)mapped_text[old_len]);
+			snapshots.line_changed(last -1);
+			brackets.line_changed(last -1);
+			invalidate_lines(last -1, last);
+		}
+		u64 from = max(b, old_len);
+		indx_t added = line_index.line_count -old_count;
+		
+		if (added < (indx_t)Line_Pages<Line>::PAGE_LINES) { // a few lines, they are on screen anyway, and mapping them would make a tiny page for every change
+			insert_decoded(last, mapped_text +from, mapped_len -from);
+		} else {
+			auto& t = get_line(last).text;
+			decode_utf8_lines(mapped_text +from, e -from, 0, [&] (indx_t, utf32 c) { t.push_back(c); });
+			lines.append_mapped(old_count, added);
+		}
+		
+		appended(last, added, cursor_at_end);
+		return true;
+	}
+	
+	// streaming from a pipe (cedi -) or a decompressor
+	//  stdin can't be mapped or seeked, a thread reads whatever arrives (up to STREAM_CHUNK at once) and hands it to the main thread, which appends it like follow mode does
+	//  the reader stops reading while STREAM_MAX_PENDING bytes wait for the main thread, so a fast producer makes memory grow only by what the buffer itself needs
+	static const uptr STREAM_CHUNK = 256 * 1024;
+	static const uptr STREAM_MAX_PENDING = 16 * 1024 * 1024;
+	
+	struct Stream_State { // shared with the reader thread, every stream gets its own, so an abandoned reader can't touch the state of the next stream
+		std::mutex				m;
+		std::condition_variable	cv;
+		std::vector<byte>		pending; // read, but not taken by the main thread yet
+		bool					eof = false;
+		bool					quit = false;
+	};
+	
+	bool							streaming = false;
+	std::thread						stream_thread;
+	std::shared_ptr<Stream_State>	stream;
+	bool							stream_from_pipe;
+	
+	std::vector<byte>		stream_tail; // a cut off utf8 sequence that was not appended yet (at most 3 bytes), with the newly arrived bytes appended
+	u64						stream_total;
+	bool					stream_bom_checked;
+	
+	std::string							stream_index_path; // not empty: build the line index of the appended bytes and save it there at the end (gzip files, so reopening them does not need to inflate everything)
+	Line_Index::Sidecar_Header			stream_index_stamp;
+	
+	// read(void* buf, uptr size) gets called on the reader thread until it returns <= 0, like read_stdin()
+	void start_stream (std::function<sptr(void*, uptr)> read, bool from_pipe) {
+		stop_follow();
+		stop_stream();
+		journal.close(); // nothing to replay a journal over
+		close_hex_view();
+		
+		filename.clear();
+		text_loaded = true;
+		file_size = 0;
+		init_from_str(nullptr, 0);
+		
+		line_index.reset();
+		stream_index_path.clear();
+		
+		stream = std::make_shared<Stream_State>();
+		stream_tail.clear();
+		stream_total = 0;
+		stream_bom_checked = false;
+		stream_from_pipe = from_pipe;
+		streaming = true;
+		
+		auto st = stream; // not this, the thread can outlive the stream
+		stream_thread = std::thread([st, read] () {
+			std::vector<byte> chunk(STREAM_CHUNK);
+			for (;;) {
+				sptr n = read(chunk.data(), chunk.size());
+				
+				{
+					std::unique_lock<std::mutex> lck(st->m);
+					st->cv.wait(lck, [&] () { return st->quit || st->pending.size() < STREAM_MAX_PENDING; });
+					if (st->quit) return;
+					
+					if (n > 0)	st->pending.insert(st->pending.end(), chunk.data(), chunk.data() +n);
+					else		st->eof = true;
+				}
+				glfwPostEmptyEvent(); // wake up the main loop
+				
+				if (n <= 0) return;
+			}
+		});
+	}
+	void open_stdin () {
+		start_stream(read_stdin, true); // read_stdin returns what is available, so slow producers (journalctl -f) show up right away
+		printf("stream: reading stdin\n");
+	}
+	void stop_stream () {
+		if (!streaming) return;
+		
+		bool eof;
+		{
+			std::lock_guard<std::mutex> lck(stream->m);
+			stream->quit = true;
+			eof = stream->eof;
+		}
+		stream->cv.notify_one();
+		
+		// a read from a pipe can't be interrupted, if the writer is still going the thread gets abandoned, it quits after its next read returns
+		//  it keeps its stream state alive until then, which nothing else references anymore
+		if (eof || !stream_from_pipe)	stream_thread.join();
+		else							stream_thread.detach();
+		stream = nullptr;
+		streaming = false;
+	}
+	
+	#if CEDI_GZIP
+	bool open_gzip (cstr filename) { // returns false if it is not a gzip file, called from open_file()
+		Mapped_File gz = {};
+		if (!map_file(filename, &gz)) return false;
+		if (!is_gzip(gz.data, gz.size)) {
+			unmap_file(&gz);
+			return false;
+		}
+		
+		Gzip_Index::Sidecar_Header stamp = {};
+		get_file_stamp(filename, &stamp.file_size, &stamp.file_mtime);
+		stamp.content_hash = Line_Index::content_hash((utf8 const*)gz.data, gz.size);
+		
+		auto sidecar = prints("%s.cedi-gzindex", filename);
+		
+		Line_Index::Sidecar_Header line_stamp = {}; // the line index of the output is only valid as long as the compressed file does not change
+		line_stamp.file_size =		stamp.file_size;
+		line_stamp.file_mtime =		stamp.file_mtime;
+		line_stamp.content_hash =	stamp.content_hash;
+		
+		auto line_sidecar = prints("%s.cedi-index", filename);
+		
+		auto text = std::unique_ptr<Gzip_Text>(new Gzip_Text);
+		if (text->index.load_sidecar(sidecar.c_str(), stamp)) {
+			text->in = gz.data;
+			text->in_len = gz.size;
+			
+			byte start[sizeof(UTF8_BOM)];
+			u64 bom = 0;
+			if (text->index.total_out >= arrlen(UTF8_BOM)) {
+				text->read(0, arrlen(UTF8_BOM), start);
+				if (memcmp(start, UTF8_BOM, arrlen(UTF8_BOM)) == 0) bom = arrlen(UTF8_BOM);
+			}
+			
+			Line_Index index;
+			if (index.load_sidecar(line_sidecar.c_str(), line_stamp, text->index.total_out -bom)) {
+				printf("gzip: %llu MB in %u spans, %lld lines, spans get inflated when they are viewed\n", (unsigned long long)(text->index.total_out / (1024 * 1024)),
+						(u32)text->index.checkpoints.size(), (long long)index.line_count);
+				init_gzip(gz, std::move(text), std::move(index), bom);
+				return true;
+			}
+			printf("gzip: line index of '%s' does not match, inflating from the start\n", filename);
+		}
+		
+		// first open, inflate it as a stream, which builds the index
+		auto r = std::make_shared<Gzip_Reader>();
+		if (!r->init(gz, stamp, sidecar)) return false;
+		start_stream([r] (void* buf, uptr size) { return r->read((byte*)buf, size); }, false);
+		stream_index_path = line_sidecar;
+		stream_index_stamp = line_stamp;
+		printf("gzip: streaming '%s'\n", filename);
+		return true;
+	}
+	void init_gzip (Mapped_File cr gz, std::unique_ptr<Gzip_Text>&& text, Line_Index&& index, u64 bom) { // like init_mapped(), the lines are in text instead of mapped_text
+		drop_lines();
+		
+		mapped = std::make_shared<Mapped_Source>();
+		mapped->file = gz;
+		mapped->gz = std::move(text);
+		mapped->gz_bom = bom;
+		mapped_text = nullptr;
+		mapped_len = index.text_len;
+		line_index = std::move(index);
+		
+		filename.clear(); // there is nothing to follow or journal for a compressed file
+		text_loaded = true;
+		
+		lines.append_mapped(0, line_index.line_count);
+		
+		snapshots.reset(lines.size());
+		brackets.reset(lines.size());
+		folds.reset(lines.size());
+		
+		reset();
+	}
+	#endif
+	
+	bool stream_update () { // call from the main loop, returns if lines were appended
+		if (!streaming) return false;
+		
+		bool eof;
+		{
+			std::lock_guard<std::mutex> lck(stream->m);
+			if (stream->pending.size() == 0 && !stream->eof) return false;
+			
+			stream_tail.insert(stream_tail.end(), stream->pending.begin(), stream->pending.end());
+			stream->pending.clear();
+			eof = stream->eof;
+		}
+		stream->cv.notify_one();
+		
+		if (!stream_bom_checked) { // files can start with one, like a file that gets loaded
+			if (stream_tail.size() < arrlen(UTF8_BOM) && !eof) return false;
+			if (stream_tail.size() >= arrlen(UTF8_BOM) && memcmp(stream_tail.data(), UTF8_BOM, arrlen(UTF8_BOM)) == 0) {
+				stream_tail.erase(stream_tail.begin(), stream_tail.begin() +arrlen(UTF8_BOM));
+			}
+			stream_bom_checked = true;
+		}
+		
+		u64 appended = append_bytes((utf8 const*)stream_tail.data(), stream_tail.size(), eof);
+		stream_total += appended;
+		if (!stream_index_path.empty()) line_index.extend((utf8 const*)stream_tail.data(), appended);
+		stream_tail.erase(stream_tail.begin(), stream_tail.begin() +(uptr)appended);
+		
+		if (eof) {
+			stop_stream();
+			printf("stream: %llu bytes, %lld lines\n", (unsigned long long)stream_total, (long long)lines.size());
+			std::vector<byte>().swap(stream_tail);
+			
+			if (!stream_index_path.empty()) line_index.save_sidecar(stream_index_path.c_str(), stream_index_stamp);
+		}
+		return true;
+	}
+	
+	// code folding (ALT+Z folds the block below the cursor line, or opens the fold there)
+	//  a fold hides lines after its header line, everything that gets drawn or scrolled counts rows (the lines that are not hidden),
+	//  cursor.l stays a line of the buffer and never is on a hidden line
+	Fold_Set	folds;
+	
+	indx_t get_indent (indx_t l) { // columns of leading whitespace, -1 for a blank line
+		indx_t col = 0;
+		bool blank = true;
+		get_line(l).text.iterate(0, [&] (indx_t, utf32 c) {
+			if (c == U' ')			col += 1;
+			else if (c == U'\t')	col += opt.tab_spaces -(col % opt.tab_spaces);
+			else {
+				blank = c == U'\n' || c == U'\r';
+				return false;
+			}
+			return true;
+		});
+		return blank ? -1 : col;
+	}
+	indx_t find_fold_end (indx_t header) { // lines [header +1, end) make up the block below header, header +1 if there is none
+		indx_t count = (indx_t)lines.size();
+		auto& h = get_line(header).text;
+		
+		indx_t last = get_line(header).get_newlineless_len();
+		while (last > 0 && (h[last -1] == U' ' || h[last -1] == U'\t')) --last;
+		
+		if (last > 0 && h[last -1] == U'{') { // brace block, up to the line with the matching '}', which stays visible
+			Cursor match;
+			if (!find_matching_bracket({ header, last -1 }, &match)) return header +1; // unbalanced
+			return max(match.l, header +1);
+		}
+		
+		// indentation block, the following lines that are indented deeper, including blank lines between them
+		indx_t indent = get_indent(header);
+		indx_t end = header +1;
+		for (indx_t l=header +1; l<count; ++l) {
+			indx_t i = get_indent(l);
+			if (i < 0) continue;
+			if (i <= indent) break;
+			end = l +1;
+		}
+		return end;
+	}
+	
+	void reveal_line (indx_t l) { // open the fold hiding line l
+		if (!hex_view && folds.unfold(l)) invalidate_layout();
+	}
+	void toggle_fold () {
+		if (hex_view) return;
+		
+		indx_t l = cursor.l;
+		if (l +1 < (indx_t)lines.size() && folds.is_hidden(l +1)) {
+			folds.unfold(l +1);
+		} else {
+			indx_t end = find_fold_end(l);
+			if (end <= l +1) return;
+			folds.fold(l +1, end);
+			
+			if (folds.is_hidden(select_cursor.l)) select_cursor = cursor;
+		}
+		
+		invalidate_layout();
+		constrain_scroll_to_cursor();
+	}
+	
+	// bracket matching (ALT+B jumps to the match of the bracket at the cursor, the two get highlighted)
+	Bracket_Index	brackets;
+	
+	void update_brackets () {
+		lines.update_page_first();
+		brackets.update([this] (indx_t l, Bracket_Sum* s) { // runs on worker threads
+			indx_t i;
+			auto& pg = lines.page_of(l, &i);
+			if (pg.is_mapped()) { // brackets are ascii, so the bytes can be counted without decoding
+				u64 len;
+				auto* str = get_mapped_lines(pg.mapped_first +i, 1, &len);
+				for (u64 pos=0; pos<len; ++pos) s->add_char((utf32)(u8)str[pos]);
+			} else {
+				pg.lines[(uptr)i].text.iterate(0, [&] (indx_t, utf32 c) { s->add_char(c); return true; });
+			}
+		});
+	}
+	
+	indx_t scan_for_bracket (indx_t l, indx_t from, s32 k, bool forward, s32* depth) { // chars of line l after (or before) char from, returns the char where depth drops to 0, -1 if none
+		auto& t = get_line(l).text;
+		indx_t found = -1;
+		if (forward) {
+			t.iterate(from +1, [&] (indx_t i, utf32 c) {
+				s32 d;
+				if (bracket_kind(c, &d) != k) return true;
+				*depth += d;
+				if (*depth == 0) found = i;
+				return found < 0;
+			});
+		} else {
+			for (indx_t i=from -1; i>=0 && found<0; --i) {
+				s32 d;
+				if (bracket_kind(t[i], &d) != k) continue;
+				*depth -= d;
+				if (*depth == 0) found = i;
+			}
+		}
+		return found;
+	}
+	bool find_matching_bracket (Cursor at, Cursor* match) { // at has to be on a bracket, false if that has no match
+		auto& t = get_line(at.l).text;
+		s32 d;
+		s32 k = at.c < t.size() ? bracket_kind(t[at.c], &d) : -1;
+		if (k < 0) return false;
+		bool forward = d > 0;
+		
+		// the rest of the line first, most brackets match on the same line, that does not need the index
+		s32 depth = 1;
+		indx_t c = scan_for_bracket(at.l, at.c, k, forward, &depth);
+		indx_t l = at.l;
+		if (c < 0) {
+			update_brackets();
+			if (!brackets.find_line(at.l, (u32)k, forward, &depth, &l)) return false;
+			c = scan_for_bracket(l, forward ? -1 : get_line(l).text.size(), k, forward, &depth);
+			dbg_assert(c >= 0);
+		}
+		*match = { l, c };
+		return c >= 0;
+	}
+	
+	// the highlight in the layout must not make a huge file that was just opened (or appended to) wait for the scan of all of it,
+	//  until ALT+B or a brace fold built the index, it only looks for the match in the lines on screen, a match further away does not get highlighted
+	static const u32 LAYOUT_BRACKET_PAGES = 16; // an index update that scans more pages than this is left for ALT+B
+	
+	bool find_visible_matching_bracket (Cursor at, indx_t first, indx_t end, Cursor* match) { // lines [first, end) are on screen
+		if (brackets.unscanned <= LAYOUT_BRACKET_PAGES) return find_matching_bracket(at, match); // edits only leave a few pages to rescan
+		
+		s32 d;
+		s32 k = bracket_kind(get_line(at.l).text[at.c], &d);
+		bool forward = d > 0;
+		
+		s32 depth = 1;
+		indx_t l = at.l;
+		indx_t c = scan_for_bracket(l, at.c, k, forward, &depth);
+		
+		// folded lines count, but a fold can hide any number of them, so only up to a few pages of lines
+		indx_t budget = (indx_t)(LAYOUT_BRACKET_PAGES * Bracket_Index::PAGE_LINES);
+		while (c < 0) {
+			l += forward ? +1 : -1;
+			if (l < first || l >= end || --budget < 0) return false;
+			c = scan_for_bracket(l, forward ? -1 : get_line(l).text.size(), k, forward, &depth);
+		}
+		*match = { l, c };
+		return true;
+	}
+	bool bracket_at_cursor (Cursor* b) { // the char at the cursor, or the one before it (cursor right after a closing bracket)
+		if (hex_view) return false;
+		auto& t = get_line(cursor.l).text;
+		s32 d;
+		for (indx_t c : { cursor.c, cursor.c -1 }) {
+			if (c >= 0 && c < t.size() && bracket_kind(t[c], &d) >= 0) {
+				*b = { cursor.l, c };
+				return true;
+			}
+		}
+		return false;
+	}
+	void jump_to_matching_bracket () {
+		Cursor b, match;
+		if (!bracket_at_cursor(&b) || !find_matching_bracket(b, &match)) return;
+		
+		reveal_line(match.l);
+		cursor = match;
+		cursor_move_reset();
+	}
+	
+	// find next (F3), searches for the selected text (or the word at the cursor) after the cursor, wrapping around at the end
+	//  the search runs on a snapshot on a worker, so typing continues while a huge file gets searched,
+	//  the match is only jumped to if the buffer did not change in the meantime, else the search restarts on a new snapshot
+	struct Search {
+		Job_Group			group;
+		std::vector<utf32>	query;
+		u64					version; // of the snapshot that gets searched
+		
+		std::atomic<bool>	done {false};
+		bool				found;
+		Cursor				match;
+	};
+	std::shared_ptr<Search>	search; // null if no search is running
+	
+	static bool is_word_char (utf32 c) {
+		return c == U'_' || (c >= U'0' && c <= U'9') || (c >= U'a' && c <= U'z') || (c >= U'A' && c <= U'Z') || c > 0x7f;
+	}
+	
+	static bool find_in_snapshot (Buffer_Snapshot cr snap, std::vector<utf32> cr query, Cursor from, Cursor* match, Job_Group* cancel=nullptr) { // first match at or after from, wraps around to the start
+		indx_t n = snap.line_count;
+		Snapshot_Reader reader; // decodes the mapped pages of the snapshot
+		
+		for (indx_t i=0; i<=n; ++i) { // line from.l gets searched twice, from from.c on at first, and only the matches that start before from.c after wrapping
+			if ((i % 256) == 0 && cancel && cancel->is_cancelled()) return false;
+			
+			indx_t l = (from.l +i) % n;
+			auto ln = snap.get_line(l, &reader);
+			
+			indx_t b = i == 0 ? min(from.c, ln.len) : 0;
+			indx_t e = i == n ? min(from.c +(indx_t)query.size() -1, ln.len) : ln.len;
+			if (e -b < (indx_t)query.size()) continue;
+			
+			auto* m = std::search(ln.text +b, ln.text +e, query.begin(), query.end());
+			if (m != ln.text +e) {
+				*match = { l, (indx_t)(m -ln.text) };
+				return true;
+			}
+		}
+		return false;
+	}
+	
+	void start_search (std::vector<utf32> query, Cursor from) {
+		cancel_search();
+		
+		auto snap = snapshot();
+		auto s = std::make_shared<Search>();
+		s->query = std::move(query);
+		s->version = snap->version;
+		search = s;
+		
+		g_jobs.submit(&s->group, JOB_PRIO_LOW, [s, snap, from] () { // owns the snapshot and the search, the buffer can drop both meanwhile
+			s->found = find_in_snapshot(*snap, s->query, from, &s->match, &s->group);
+			s->done.store(true, std::memory_order_release);
+			glfwPostEmptyEvent(); // wake up the main loop
+		});
+	}
+	void cancel_search () {
+		if (search) search->group.cancel();
+		search = nullptr;
+	}
+	
+	void find_next () {
+		if (hex_view) return;
+		
+		Cursor a = cursor, b = cursor;
+		if (selecting != SEL_NOT_SELECTING && select_cursor.l == cursor.l && select_cursor != cursor) {
+			a.c = min(cursor.c, select_cursor.c);
+			b.c = max(cursor.c, select_cursor.c);
+		} else { // word at the cursor
+			auto& ln = get_line(cursor.l);
+			auto& t = ln.text;
+			indx_t len = ln.get_newlineless_len();
+			while (a.c > 0 && is_word_char(t[a.c -1]))	--a.c;
+			while (b.c < len && is_word_char(t[b.c]))	++b.c;
+		}
+		if (a.c == b.c) return;
+		
+		std::vector<utf32> query;
+		auto& t = get_line(a.l).text;
+		for (indx_t c=a.c; c<b.c; ++c) query.push_back(t[c]);
+		
+		start_search(std::move(query), b); // after the text at the cursor, so F3 again finds the next one
+	}
+	
+	bool search_update () { // main loop, returns true if the search finished
+		if (!search || !search->done.load(std::memory_order_acquire)) return false;
+		
+		auto s = search;
+		search = nullptr;
+		
+		if (s->version != snapshots.version) { // edited while searching, the match could be in the wrong place now
+			start_search(std::move(s->query), cursor);
+			return false;
+		}
+		if (!s->found) {
+			printf("find: no match\n");
+			return false;
+		}
+		
+		reveal_line(s->match.l);
+		select_cursor = s->match;
+		cursor = { s->match.l, s->match.c +(indx_t)s->query.size() };
+		selecting = SEL_KEY_RELEASED; // selected like after shift was released, the next cursor move deselects it
+		cursor_move_reset();
+		invalidate_layout();
+		return true;
+	}
+	
+	// hex view (ALT+X), files that are not text open in it directly
+	//  rows are drawn straight from a mapping of the file, only the rows in the window get looked at, nothing gets decoded or indexed,
+	//  a row is HEX_ROW_BYTES bytes in hex followed by the same bytes as ascii, the line numbers are the byte offsets of the rows
+	//  the view is read-only, cursor.l is a row and cursor.c a byte in the row
+	static const u32 HEX_ROW_BYTES = 16;
+	
+	bool			hex_view = false;
+	bool			text_loaded = true; // false if the file was opened straight into the hex view, then there is no text to switch back to
+	Mapped_File		hex_mapped = {};
+	
+	static bool is_binary_file (cstr filename) { // looks at the start of the file only, invalid utf8 further in just decodes to U+FFFD
+		auto f = fopen(filename, "rb");
+		if (!f) return false;
+		defer { fclose(f); };
+		
+		byte head[64 * 1024];
+		uptr len = fread(head, 1, sizeof(head), f);
+		return looks_binary(head, len);
+	}
+	
+	bool open_hex_view () {
+		if (filename.empty() || !map_file(filename.c_str(), &hex_mapped)) {
+			printf("hex view: can't map '%s'!\n", filename.c_str());
+			return false;
+		}
+		stop_follow();
+		hex_view = true;
+		reset();
+		printf("hex view: %llu bytes\n", (unsigned long long)hex_mapped.size);
+		return true;
+	}
+	void close_hex_view () {
+		if (!hex_view) return;
+		unmap_file(&hex_mapped);
+		hex_view = false;
+		reset();
+	}
+	void toggle_hex_view () {
+		if (!hex_view) {
+			open_hex_view();
+		} else if (!text_loaded) {
+			printf("hex view: '%s' is not text\n", filename.c_str());
+		} else {
+			close_hex_view();
+		}
+	}
+	
+	indx_t view_line_count () { // rows in the view, the lines that are not folded away, or the rows of the hex view
+		if (!hex_view) return folds.row_count();
+		return max((indx_t)((hex_mapped.size +HEX_ROW_BYTES -1) / HEX_ROW_BYTES), (indx_t)1);
+	}
+	indx_t row_of_line (indx_t l) {		return hex_view ? l : folds.row_of_line(l); } // there is no folding in the hex view
+	indx_t line_of_row (indx_t row) {	return hex_view ? row : folds.line_of_row(row); }
+	u32 hex_row_len (indx_t row) {
+		u64 offs = (u64)row * HEX_ROW_BYTES;
+		return offs < hex_mapped.size ? (u32)min(hex_mapped.size -offs, (u64)HEX_ROW_BYTES) : 0;
+	}
+	static indx_t hex_byte_col (indx_t i) { // "xx " per byte, with an extra space in the middle
+		return i * 3 +(i >= HEX_ROW_BYTES / 2 ? 1 : 0);
+	}
+	indx_t get_max_cursor_c (indx_t l) {
+		if (!hex_view) return get_line(l).get_max_cursor_c();
+		return max((indx_t)hex_row_len(l) -1, (indx_t)0); // cursor is on a byte, there is no newline to put it on
+	}
+	
+	struct Cursor_Box {
+		v2 pos;
+		v2 dim;
+	};
+	Cursor_Box				cursor_box;
+	Arena_Array<Cursor_Box>	selection_boxes; // in the frame arena
+	
+	// layout cache
+	//  all layout is positioned relative to layout_anchor (a line index) and the shaders translate it by scroll_offset_px,
+	//  so smooth scrolling only changes a uniform, and only lines that newly enter the window get laid out
+	//  the glyphs of the cached lines live in fixed size slots of a persistent vbo, row r is in slot r % slot count,
+	//  so only the slots of lines that were laid out again or left the cache get copied and uploaded
+	struct Glyph_Geometry { // shared with the render thread, only modified once the render thread let go of it
+		u64							gen =		0; // gen of the newest slot
+		u64							slots_gen =	0; // changes when the slot count or size changes, the render thread then reallocates the vbo and uploads every slot
+		u32							slot_cap; // verts per slot
+		struct Slot {
+			u64							gen; // gen the slot last changed in, the render thread uploads the slots newer than what it uploaded last
+			std::vector<VBO_Text::V>	verts;
+		};
+		std::vector<Slot>			slots;
+	};
+	
+	bool									layout_dirty = true; // everything needs to be laid out again (option changes, resize, horizontal scroll)
+	indx_t									relayout_first = 0; // cached lines [relayout_first, relayout_end) need to be laid out again (edits)
+	indx_t									relayout_end = 0;
+	
+	// state the cached layout depends on, that can change implicitly
+	indx_t									layout_scroll_col;
+	u32										layout_digit_count;
+	indx_t									layout_cursor_row; // line number of the cursor line is highlighted
+	Cursor									layout_brackets[2]; // highlighted bracket pair, l = -1 if none
+	
+	indx_t									layout_anchor;
+	struct Line_Layout {
+		std::vector<VBO_Text::V>	verts; // glyphs of the line
+		
+		f32							pos_y;
+		indx_t						chars_x_first; // char index of chars_x_px[0], only the chars in the visible column window are laid out
+		std::vector<f32>			chars_x_px;
+	};
+	
+	indx_t									layout_first; // cached lines are [layout_first, layout_first +line_layouts.size())
+	std::deque<Line_Layout>					line_layouts;
+	std::vector<Line_Layout>				free_line_layouts; // reuse the vectors of lines that left the window
+	
+	std::shared_ptr<Glyph_Geometry>					glyphs;
+	std::vector< std::shared_ptr<Glyph_Geometry> >	glyphs_pool;
+	u64												glyphs_gen = 0;
+	std::vector<u64>								glyph_slot_gens; // gen every slot last changed in, its size is the slot count
+	u32												glyph_slot_cap = 0;
+	u64												glyph_slots_gen = 0;
+	
+	f32										scroll_offset_px; // layout space -> window space translation for the current smooth_scroll
+	
+	// damage tracking
+	//  rows of the window (in layout space) that changed since the last frame, the render thread only redraws those
+	struct Damage_Row {
+		f32 y0, y1;
+	};
+	bool									damage_all = true;
+	Arena_Array<Damage_Row>					damage; // in the frame arena
+	
+	Cursor_Box								prev_cursor_box = {}; // boxes of the last frame, to damage the rows of boxes that changed
+	Arena_Array<Cursor_Box>					prev_selection_boxes; // still in the arena of the last snapshot, which does not get reset before the next snapshot was published
+	
+	bool									layout_changed; // last generate_layout() had to lay out lines or rebuild the glyph geometry
+	
+	void begin_frame (Frame_Arena* arena) { // all transient layout output of this frame gets allocated from arena
+		selection_boxes.init(arena);
+		damage.init(arena);
+	}
+	
+	void invalidate_layout () {
+		layout_dirty = true;
+	}
+	void invalidate_lines (indx_t first, indx_t end) { // lines of the buffer, end can be past the last line (lines that moved out of the buffer)
+		indx_t count = (indx_t)lines.size();
+		invalidate_rows(row_of_line(min(first, count)), row_of_line(min(end, count)) +max(end -count, (indx_t)0));
+	}
+	void invalidate_rows (indx_t first, indx_t end) {
+		if (relayout_first == relayout_end) {
+			relayout_first = first;
+			relayout_end = end;
+		} else {
+			relayout_first =	min(relayout_first, first);
+			relayout_end =		max(relayout_end, end);
+		}
+	}
+	
+	void damage_box (Cursor_Box cr b) {
+		if (b.dim.x == 0 && b.dim.y == 0) return; // cursor not laid out
+		damage.push_back({ b.pos.y -1, b.pos.y +b.dim.y +1 }); // +-1 px for antialiased glyph edges
+	}
+	void damage_line (indx_t row) {
+		f32 y = opt.tex_buffer_margin +(f32)g_font.line_height * (f32)(row -layout_anchor);
+		damage.push_back({ y -1, y +g_font.line_height +1 });
+	}
+	
+	std::shared_ptr<Glyph_Geometry> get_free_glyph_geometry () {
+		for (auto& g : glyphs_pool) {
+			if (g.use_count() == 1) return g; // not referenced by any snapshot anymore
+		}
+		glyphs_pool.push_back( std::make_shared<Glyph_Geometry>() );
+		return glyphs_pool.back();
+	}
+	
+	void layout_line (indx_t row, Line_Layout* ll) {
+		auto* out = &ll->verts;
+		out->clear();
+		
+		damage_line(row);
+		indx_t line_i = line_of_row(row);
+		
+		auto col_rules = get_col_rules();
+		
+		u32 digit_count = get_line_number_digits();
+		
+		f32 text_x_px = get_text_x_px();
+		f32 max_x_px = (f32)sub_wnd_dim.x; // stop emitting chars once we are past the right window edge
+		
+		f32	pos_x_px = g_font.border_left +opt.tex_buffer_margin;
+		f32	pos_y_px = g_font.ascent_plus_gap +opt.tex_buffer_margin +((f32)g_font.line_height * (f32)(row -layout_anchor));
+		
+		auto emit_glyph = [&] (utf32 c, v3 col) {
+			pos_x_px = g_font.emit_glyph(out, pos_x_px,pos_y_px, c, v4(col,1));
+		};
+		
+		{ // emit line numbers
+			v3 col = opt.col_line_numbers;
+			
+			//if (selecting && line_i >= cursor_low->l && line_i <= cursor_high->l)
+			//	col = opt.col_selection.xyz();
+			if (line_i == cursor.l)
+				col = opt.col_cursor.xyz();
+			
+			u32 base = hex_view ? 16 : 10;
+			u64 num = hex_view ? (u64)line_i * HEX_ROW_BYTES : (u64)line_i;
+			utf32 buf[32];
+			u32 num_len = 0;
+			for (; num_len<digit_count; ++num_len) {
+				if (num_len > 0 && num == 0) break;
+				buf[num_len] = (utf32)(num % base);
+				num /= base;
+			}
+			num_len = max(num_len, (u32)1);
+			
+			for (u32 i=digit_count; i!=0;) { --i;
+				emit_glyph(i < num_len ? (utf32)HEX_DIGITS[buf[i]] : U' ', col);
+			}
+			emit_glyph(U'|', opt.col_line_numbers_bar);
+		}
+		
+		if (hex_view) {
+			layout_hex_row(line_i, ll, pos_y_px);
+			return;
+		}
+		
+		auto& l = get_line(line_i);
+		
+		// start at the char covering scroll_col, the column index finds it without looking at the chars before
+		indx_t tab_char_i;
+		indx_t first_char_i = l.text.find_col(scroll_col, col_rules, &tab_char_i);
+		
+		pos_x_px = text_x_px +(f32)(tab_char_i -scroll_col) * g_font.char_w; // first char might start left of scroll_col (a tab)
+		
+		ll->pos_y = pos_y_px;
+		ll->chars_x_first = first_char_i;
+		ll->chars_x_px.clear();
+		
+		auto emit_char = [&] (utf32 c, v3 col) {
+			if (pos_x_px < text_x_px) { // part of a tab that was scrolled under the line numbers
+				pos_x_px += g_font.char_w;
+				return;
+			}
+			emit_glyph(c, col);
+		};
+		auto emit_escaped_char = [&] (utf32 c) {
+			auto tmp = pos_x_px;
+			emit_char(U'\\', opt.col_draw_whitespace);
+			pos_x_px = lerp(tmp, pos_x_px, 0.6f); // squash \ and c closer together to make it seem like 1 glyph
+			
+			emit_char(c, opt.col_draw_whitespace);
+			++tab_char_i;
+		};
+		auto emit_tab = [&] () {
+			indx_t spaces_needed = opt.tab_spaces -(tab_char_i % opt.tab_spaces);
+			
+			for (indx_t j=0; j<spaces_needed; ++j) {
+				auto c = U' ';
+				if (opt.draw_whitespace) {
+					c = j<spaces_needed-1 ? U'—' : U'→';
+				}
+				
+				emit_char(c, opt.col_draw_whitespace);
+				
+				++tab_char_i;
+			}
+		};
+		
+		l.text.iterate(first_char_i, [&] (indx_t char_i, utf32 c) {
+			if (pos_x_px > max_x_px) return false; // rest of the line is right of the window
+			
+			ll->chars_x_px.push_back(pos_x_px);
+			
+			switch (c) {
+				case U'\t': {
+					emit_tab();
+				} break;
+				
+				case U'\n': {
+					if (opt.draw_whitespace) emit_escaped_char(U'n');
+				} break;
+				case U'\r': {
+					if (opt.draw_whitespace) emit_escaped_char(U'r');
+				} break;
+				case U'\0': {
+					emit_escaped_char(U'0');
+				} break;
+				
+				case U' ': {
+					if (opt.draw_whitespace) {
+						emit_char(U'·', opt.col_draw_whitespace);
+					} else {
+						emit_char(c, opt.col_text);
+					}
+					
+					++tab_char_i;
+				} break;
+				
+				default: {
+					bool match = (line_i == layout_brackets[0].l && char_i == layout_brackets[0].c) || (line_i == layout_brackets[1].l && char_i == layout_brackets[1].c);
+					emit_char(c, match ? opt.col_bracket_match : opt.col_text);
+					++tab_char_i;
+				} break;
+			}
+			return true;
+		});
+		
+		ll->chars_x_px.push_back(pos_x_px); // push char pos for imaginary last character (or the first char right of the window), to be able to determine width of last char
+		
+		if (line_i +1 < (indx_t)lines.size() && folds.is_hidden(line_i +1)) { // fold marker after the header line
+			for (cstr s=" ..."; *s && pos_x_px <= max_x_px; ++s) emit_char((utf32)*s, opt.col_draw_whitespace);
+		}
+	}
+	
+	void layout_hex_row (indx_t row, Line_Layout* ll, f32 pos_y_px) {
+		auto* out = &ll->verts;
+		
+		f32 text_x_px = get_text_x_px();
+		f32 max_x_px = (f32)sub_wnd_dim.x;
+		f32 pos_x_px = text_x_px -(f32)scroll_col * g_font.char_w;
+		
+		ll->pos_y = pos_y_px;
+		ll->chars_x_first = 0;
+		ll->chars_x_px.clear();
+		
+		auto emit_char = [&] (utf32 c, v3 col) {
+			if (pos_x_px < text_x_px || pos_x_px > max_x_px) { // scrolled under the line numbers or right of the window
+				pos_x_px += g_font.char_w;
+				return;
+			}
+			pos_x_px = g_font.emit_glyph(out, pos_x_px,pos_y_px, c, v4(col,1));
+		};
+		
+		u32 len = hex_row_len(row);
+		byte const* bytes = hex_mapped.data +(u64)row * HEX_ROW_BYTES;
+		
+		for (u32 i=0; i<HEX_ROW_BYTES; ++i) {
+			if (i == HEX_ROW_BYTES / 2) emit_char(U' ', opt.col_text);
+			if (i <= len) ll->chars_x_px.push_back(pos_x_px); // +1 for the end of the last byte, like the imaginary last char of text lines
+			
+			if (i < len) {
+				v3 col = bytes[i] ? opt.col_text : opt.col_draw_whitespace;
+				emit_char((utf32)HEX_DIGITS[bytes[i] >> 4], col);
+				emit_char((utf32)HEX_DIGITS[bytes[i] & 15], col);
+			} else { // short last row, keep the ascii column aligned
+				emit_char(U' ', opt.col_text);
+				emit_char(U' ', opt.col_text);
+			}
+			emit_char(U' ', opt.col_text);
+		}
+		if (len == HEX_ROW_BYTES) ll->chars_x_px.push_back(pos_x_px -g_font.char_w); // end of the last byte, without its trailing space
+		
+		emit_char(U' ', opt.col_text);
+		for (u32 i=0; i<len; ++i) {
+			bool printable = bytes[i] >= 0x20 && bytes[i] < 0x7f;
+			emit_char(printable ? (utf32)bytes[i] : U'.', printable ? opt.col_text : opt.col_draw_whitespace);
+		}
+	}
+	
+	void generate_layout () {
+		
+		// lay out the lines visible now and at the scroll target, so the whole smooth scroll animation can reuse the layout
+		indx_t first, end;
+		{
+			auto vis =		get_visible_line_range();
+			auto target =	get_line_range_at(scroll);
+			first =	min(vis.first, target.first);
+			end =	max(vis.first +vis.count, target.first +target.count);
+		}
+		
+		if (abs(first -layout_anchor) > 4096) {
+			layout_dirty = true; // keep layout space coordinates small, so float precision stays good
+		}
+		
+		u32 digit_count = get_line_number_digits();
+		if (scroll_col != layout_scroll_col || digit_count != layout_digit_count) {
+			layout_dirty = true; // every line moved horizontally
+		}
+		indx_t cursor_row = row_of_line(cursor.l);
+		if (cursor_row != layout_cursor_row) {
+			invalidate_rows(layout_cursor_row, layout_cursor_row +1);
+			invalidate_rows(cursor_row, cursor_row +1);
+		}
+		{
+			indx_t first_line = line_of_row(first);
+			indx_t end_line = line_of_row(max(end -1, first)) +1;
+			
+			Cursor pair[2] = { {-1,0}, {-1,0} };
+			if (bracket_at_cursor(&pair[0]) && !find_visible_matching_bracket(pair[0], first_line, end_line, &pair[1])) pair[0] = pair[1];
+			
+			if (pair[0] != layout_brackets[0] || pair[1] != layout_brackets[1]) {
+				for (auto& b : { layout_brackets[0], layout_brackets[1], pair[0], pair[1] }) {
+					if (b.l >= 0) invalidate_lines(b.l, b.l +1);
+				}
+				layout_brackets[0] = pair[0];
+				layout_brackets[1] = pair[1];
+			}
+		}
+		
+		bool changed = layout_dirty;
+		
+		u64 gen = glyphs_gen +1;
+		auto touch_slot = [&] (indx_t row) { // the glyphs of row changed
+			if (glyph_slot_gens.size()) glyph_slot_gens[ (uptr)(row % (indx_t)glyph_slot_gens.size()) ] = gen;
+			changed = true;
+		};
+		
+		if (layout_dirty) {
+			for (auto& slot_gen : glyph_slot_gens) slot_gen = gen; // the slots of the dropped lines are empty now
+			for (auto& ll : line_layouts) free_line_layouts.push_back( std::move(ll) );
+			line_layouts.clear();
+			
+			layout_anchor = first;
+			layout_first = first;
+			layout_dirty = false;
+			
+			damage_all = true;
+		}
+		
+		layout_scroll_col = scroll_col;
+		layout_digit_count = digit_count;
+		layout_cursor_row = cursor_row;
+		
+		auto alloc_line_layout = [&] () {
+			Line_Layout ll;
+			if (free_line_layouts.size()) {
+				ll = std::move(free_line_layouts.back());
+				free_line_layouts.pop_back();
+			}
+			return ll;
+		};
+		
+		{ // lay out invalidated lines again
+			indx_t b = max(relayout_first, layout_first);
+			indx_t e = min(min(relayout_end, layout_first +(indx_t)line_layouts.size()), end); // rows past the end of the buffer get dropped below
+			for (indx_t row=b; row<e; ++row) {
+				layout_line(row, &line_layouts[ row -layout_first ]);
+				touch_slot(row);
+			}
+			relayout_first = 0;
+			relayout_end = 0;
+		}
+		
+		{ // drop lines that left the window, lay out lines that entered it
+			while (line_layouts.size() && layout_first < first) {
+				damage_line(layout_first);
+				touch_slot(layout_first);
+				free_line_layouts.push_back( std::move(line_layouts.front()) );
+				line_layouts.pop_front();
+				++layout_first;
+			}
+			while (line_layouts.size() && (layout_first +(indx_t)line_layouts.size()) > end) {
+				indx_t row = layout_first +(indx_t)line_layouts.size() -1;
+				damage_line(row);
+				touch_slot(row);
+				free_line_layouts.push_back( std::move(line_layouts.back()) );
+				line_layouts.pop_back();
+			}
+			if (line_layouts.size() == 0) layout_first = first;
+			
+			while (layout_first > first) {
+				--layout_first;
+				line_layouts.push_front( alloc_line_layout() );
+				layout_line(layout_first, &line_layouts.front());
+				touch_slot(layout_first);
+			}
+			while ((layout_first +(indx_t)line_layouts.size()) < end) {
+				indx_t row = layout_first +(indx_t)line_layouts.size();
+				line_layouts.push_back( alloc_line_layout() );
+				layout_line(row, &line_layouts.back());
+				touch_slot(row);
+			}
+		}
+		
+		{ // fit the slots to the cached lines, with headroom so that a few longer lines or a taller window don't reallocate every time, but shrink them again after a jump laid out many lines
+			static const u32 MIN_SLOT_CAP = 6 * 64; // 64 glyphs
+			static const uptr MIN_SLOT_COUNT = 64;
+			
+			u32 cap = 0;
+			for (auto& ll : line_layouts) cap = max(cap, (u32)ll.verts.size());
+			uptr count = line_layouts.size();
+			
+			bool grow =		cap > glyph_slot_cap || count > glyph_slot_gens.size();
+			bool shrink =	glyph_slot_cap > max(cap, MIN_SLOT_CAP) * 4 || glyph_slot_gens.size() > max(count, MIN_SLOT_COUNT) * 4;
+			if (grow || shrink) {
+				glyph_slot_cap = max(cap +cap / 2, MIN_SLOT_CAP);
+				glyph_slot_gens.assign(max(count +count / 2, MIN_SLOT_COUNT), gen); // rows map to other slots now, reupload everything
+				++glyph_slots_gen;
+				changed = true;
+			}
+		}
+		
+		layout_changed = changed || !glyphs;
+		if (layout_changed) {
+			auto g = get_free_glyph_geometry();
+			
+			bool all = g->slots_gen != glyph_slots_gen;
+			g->slots_gen = glyph_slots_gen;
+			g->slot_cap = glyph_slot_cap;
+			g->slots.resize(glyph_slot_gens.size());
+			
+			indx_t count = (indx_t)glyph_slot_gens.size();
+			indx_t layout_end = layout_first +(indx_t)line_layouts.size();
+			for (indx_t i=0; i<count; ++i) {
+				auto& slot = g->slots[i];
+				if (!all && glyph_slot_gens[i] <= g->gen) continue; // this geometry already has the current glyphs of the slot
+				
+				indx_t row = layout_first +(i -layout_first % count +count) % count; // the only cached row that can be in this slot
+				slot.verts.clear();
+				if (row < layout_end) {
+					auto& verts = line_layouts[ row -layout_first ].verts;
+					slot.verts.insert(slot.verts.end(), verts.begin(), verts.end());
+				}
+				slot.gen = glyph_slot_gens[i];
+			}
+			
+			g->gen = glyphs_gen = gen;
+			glyphs = g;
+		}
+		
+		scroll_offset_px = smooth_scroll.offset_from(layout_anchor) * g_font.line_height;
+		
+		generate_cursor_layout();
+	}
+	
+	void generate_cursor_layout () { // cursor and selection boxes are cheap, so they are always regenerated from the cached line layout
+		
+		selection_boxes.clear();
+		
+		indx_t layout_end = layout_first +(indx_t)line_layouts.size();
+		
+		Cursor* cursor_low;
+		Cursor* cursor_high;
+		{
+			if (		cursor.l == select_cursor.l ) {
+				if (cursor.c >= select_cursor.c) {
+					cursor_low =	&select_cursor;
+					cursor_high =	&cursor;
+				} else {
+					cursor_low =	&cursor;
+					cursor_high =	&select_cursor;
+				}
+			} else if (	cursor.l > select_cursor.l ) {
+				cursor_low =		&select_cursor;
+				cursor_high =		&cursor;
+			} else /* (	cursor.l < select_cursor.l */ {
+				cursor_low =		&cursor;
+				cursor_high =		&select_cursor;
+			}
+			
+			//printf(">> select %llu:%llu - %llu:%llu\n", cursor_low->l,cursor_low->c, cursor_high->l,cursor_high->c);
+		}
+		
+		if (selecting) { // emit selection boxes
+			indx_t low_row = row_of_line(cursor_low->l);
+			indx_t high_row = row_of_line(cursor_high->l);
+			for (indx_t row=max(low_row, layout_first); row<=min(high_row, layout_end -1); ++row) {
+				auto& ll = line_layouts[ row -layout_first ];
+				indx_t line_i = line_of_row(row);
+				
+				indx_t first_char_i = ll.chars_x_first;
+				indx_t end_char_i = first_char_i +(indx_t)ll.chars_x_px.size() -1;
+				
+				indx_t c = 0;
+				indx_t max_c = hex_view ? (indx_t)hex_row_len(line_i) : get_line(line_i).text.size();
+				
+				if (line_i == cursor_low->l)		c = cursor_low->c;
+				if (line_i == cursor_high->l)	max_c = cursor_high->c;
+				
+				bool ends_on_newline = !hex_view && max_c >= get_line(line_i).get_newlineless_len(); // before clipping to the visible chars
+				
+				// clip to the visible chars
+				c =		min(max(c, first_char_i), end_char_i);
+				max_c =	min(max(max_c, first_char_i), end_char_i);
+				
+				f32 x = ll.chars_x_px[c -first_char_i];
+				f32 w = ll.chars_x_px[max_c -first_char_i] -x;
+				
+				if (!opt.draw_whitespace && ends_on_newline && row != view_line_count() -1) {
+					w += opt.min_cursor_w_px;
+				}
+				
+				Cursor_Box	s = {	v2(x -g_font.border_left, ll.pos_y -g_font.line_height +g_font.descent_plus_gap),
+									v2(w, g_font.line_height) };
+				
+				if (w > 0) selection_boxes.push_back(s);
+			}
+		}
+		
+		{ // emit cursor box
+			Line_Layout* ll = nullptr;
+			indx_t i = 0;
+			indx_t cursor_row = row_of_line(cursor.l);
+			if (cursor_row >= layout_first && cursor_row < layout_end) {
+				ll = &line_layouts[ cursor_row -layout_first ];
+				i = cursor.c -ll->chars_x_first;
+			}
+			
+			bool laid_out =	ll && i >= 0 && i < (indx_t)ll->chars_x_px.size();
+			if (!laid_out) {
+				cursor_box = { 0, 0 }; // cursor was scrolled out of the window
+			} else {
+				f32 x = ll->chars_x_px[ i ];
+				
+				f32 w = 0;
+				if (i < (indx_t)(ll->chars_x_px.size() -1)) {
+					w = ll->chars_x_px[ i +1 ] -x; // could be imaginary last character
+				}
+				// w might end up zero because either the final few chars on the line are invisible (newline because draw_whitespace is off) or is not a character (end of file)
+				
+				w *= opt.min_cursor_w_percent_of_char;
+				
+				w = max(w, opt.min_cursor_w_px);
+				
+				if (selecting && *cursor_high != *cursor_low) {
+					w = opt.min_cursor_w_px;
+				}
+				
+				cursor_box = {	v2(x -g_font.border_left, ll->pos_y -g_font.line_height +g_font.descent_plus_gap),
+								v2(w, g_font.line_height) };
+			}
+		}
+		
+		{ // damage rows of boxes that appeared, disappeared or changed
+			auto same = [] (Cursor_Box cr a, Cursor_Box cr b) {
+				return a.pos.x == b.pos.x && a.pos.y == b.pos.y && a.dim.x == b.dim.x && a.dim.y == b.dim.y;
+			};
+			auto contains = [&] (Arena_Array<Cursor_Box> cr boxes, Cursor_Box cr b) {
+				for (auto& x : boxes) if (same(x, b)) return true;
+				return false;
+			};
+			
+			if (!same(cursor_box, prev_cursor_box)) {
+				damage_box(prev_cursor_box);
+				damage_box(cursor_box);
+			}
+			for (auto& b : prev_selection_boxes)	if (!contains(selection_boxes, b))		damage_box(b);
+			for (auto& b : selection_boxes)			if (!contains(prev_selection_boxes, b))	damage_box(b);
+			
+			prev_cursor_box = cursor_box;
+			prev_selection_boxes = selection_boxes;
+		}
+	}
+	
+};
+
+Text_Buffer g_buf; // init to zero/null
+static cstr g_open_filename = "build.bat"; // from the command line, "-" streams stdin
+
+// input events
+static void move_cursor_left () {		g_buf.move_cursor_left();	}
+static void move_cursor_right () {		g_buf.move_cursor_right();	}
+static void move_cursor_up () {			g_buf.move_cursor_up();		}
+static void move_cursor_down () {		g_buf.move_cursor_down();	}
+static void scroll_page_up () {			g_buf.scroll_page_up();		}
+static void scroll_page_down () {		g_buf.scroll_page_down();	}
+static void mouse_scroll (s32 diff) {	g_buf.mouse_scroll(diff);	}
+static void zoom_font (s32 diff) {
+	if (!font::sdf_atlas) return; // bitmap atlas is only valid for one size
+	
+	g_font.set_zoom( g_font.zoom * pow(opt.zoom_step, (f32)diff) );
+	printf(">> zoom %.0f%%\n", g_font.zoom * 100);
+	
+	g_buf.font_metrics_changed();
+}
+static void mouse_scroll_x (s32 diff) {	g_buf.mouse_scroll_x(diff);	}
 
 static void insert_char (utf32 c) {		g_buf.insert_char(c);		}
 static void insert_tab () {				g_buf.insert_tab();			}
@@ -654,11 +2266,585 @@ static void insert_enter () {			g_buf.insert_enter();		}
 static void delete_prev () {			g_buf.delete_prev();		}
 static void delete_next () {			g_buf.delete_next();		}
 
+static void paste (utf8 const* str, u64 len) {	g_buf.paste(str, len);	}
+
 static void start_select () {			g_buf.start_select();		}
 static void stop_select () {			g_buf.stop_select();		}
 
+static void invalidate_layout () {		g_buf.invalidate_layout();	}
+
 static void open_file (cstr filename) {	g_buf.open_file(filename);	}
 
+static int bench_load (cstr filename) { // cedi --bench-load <file>: decode speed of init_from_str for 1 to all cores, no window
+	std::vector<byte> data;
+	if (!load_file_skip_bom(filename, &data, UTF8_BOM, arrlen(UTF8_BOM)) || data.size() == 0) {
+		printf("Could not open file '%s'!\n", filename);
+		return 1;
+	}
+	f64 mb = (f64)data.size() / (1024 * 1024);
+	printf("bench_load: '%s' %.1f MB\n", filename, mb);
+	
+	u32 max_threads = Job_System::default_worker_count() +1;
+	
+	for (u32 threads=1;; threads = min(threads * 2, max_threads)) {
+		g_jobs.init(threads -1); // the main thread works too while it waits
+		
+		f64 best = INFd;
+		for (u32 i=0; i<3; ++i) {
+			auto t0 = std::chrono::steady_clock::now();
+			g_buf.init_from_str((utf8*)&data[0], data.size());
+			best = min(best, std::chrono::duration<f64>(std::chrono::steady_clock::now() -t0).count());
+		}
+		printf("  %2u threads: %8.1f ms  %8.1f MB/s  (%lld lines)\n", threads, best * 1000, mb / best, (long long)g_buf.lines.size());
+		
+		g_jobs.shutdown();
+		if (threads == max_threads) break;
+	}
+	return 0;
+}
+
+static int bench_edit (cstr filename) { // cedi --bench-edit <file>: speed of insert_text and delete_range for pastes of a few sizes into the middle of the file, no window
+	std::vector<byte> data;
+	if (!load_file_skip_bom(filename, &data, UTF8_BOM, arrlen(UTF8_BOM)) || data.size() == 0) {
+		printf("Could not open file '%s'!\n", filename);
+		return 1;
+	}
+	g_jobs.init();
+	g_buf.init_from_str((utf8*)&data[0], data.size());
+	
+	auto line_count = (Text_Buffer::indx_t)g_buf.lines.size();
+	printf("bench_edit: '%s' %.1f MB, %lld lines\n", filename, (f64)data.size() / (1024 * 1024), (long long)line_count);
+	
+	u64 text_len = complete_utf8_len((utf8*)&data[0], data.size());
+	if (text_len == 0) { // a few bytes of a cut off char, nothing to paste
+		g_jobs.shutdown();
+		return 0;
+	}
+	
+	for (u64 step = 1024 * 1024;; step *= 16) {
+		u64 size = complete_utf8_len((utf8*)&data[0], min(step, text_len)); // don't cut a char in half
+		f64 mb = (f64)size / (1024 * 1024);
+		Text_Buffer::Cursor pos = { line_count / 2, 0 };
+		
+		f64 insert = INFd, erase = INFd;
+		for (u32 i=0; i<3; ++i) {
+			auto t0 = std::chrono::steady_clock::now();
+			auto end = g_buf.insert_text(pos, (utf8*)&data[0], size);
+			auto t1 = std::chrono::steady_clock::now();
+			g_buf.delete_range(pos, end);
+			auto t2 = std::chrono::steady_clock::now();
+			
+			insert =	min(insert, std::chrono::duration<f64>(t1 -t0).count());
+			erase =		min(erase, std::chrono::duration<f64>(t2 -t1).count());
+			dbg_assert((Text_Buffer::indx_t)g_buf.lines.size() == line_count);
+		}
+		printf("  %8.1f MB:  paste %8.1f ms %8.1f MB/s   delete %8.1f ms %8.1f MB/s\n", mb, insert * 1000, mb / insert, erase * 1000, mb / erase);
+		
+		if (step >= text_len) break;
+	}
+	g_jobs.shutdown();
+	return 0;
+}
+
+// cedi --test: self tests of the buffer operations, no window, returns 1 if any failed
+static std::string buffer_utf8 (Text_Buffer::Cursor end={ (Text_Buffer::indx_t)1 << 62, 0 }) { // contents of g_buf before end, encoded as utf8 again
+	typedef Text_Buffer::indx_t indx_t;
+	
+	std::string s;
+	indx_t last = min(end.l, (indx_t)g_buf.lines.size() -1);
+	for (indx_t l=0; l<=last; ++l) {
+		g_buf.get_line(l).text.iterate(0, [&] (indx_t c_indx, utf32 c) {
+			if (l == end.l && c_indx >= end.c) return false;
+			
+			utf8 tmp[4];
+			s.append(tmp, utf32_to_utf8(c, tmp));
+			return true;
+		});
+	}
+	return s;
+}
+static std::string snapshot_utf8 (Buffer_Snapshot cr snap) { // contents of a snapshot, encoded as utf8 again
+	typedef Text_Buffer::indx_t indx_t;
+	
+	std::string s;
+	Snapshot_Reader reader;
+	for (indx_t l=0; l<snap.line_count; ++l) {
+		auto ln = snap.get_line(l, &reader);
+		for (indx_t c=0; c<ln.len; ++c) {
+			utf8 tmp[4];
+			s.append(tmp, utf32_to_utf8(ln.text[c], tmp));
+		}
+	}
+	return s;
+}
+
+static int run_tests () {
+	typedef Text_Buffer::indx_t indx_t;
+	
+	g_jobs.init();
+	u32 failed = 0;
+	
+	auto check = [&] (bool ok, cstr what) {
+		printf("  %s  %s\n", ok ? "ok  " : "FAIL", what);
+		if (!ok) ++failed;
+	};
+	
+	{ // jobs that did not start before a shutdown get dropped, a later init() starts out empty
+		Job_Group group;
+		g_jobs.shutdown();
+		g_jobs.init(0); // nothing runs the job until someone waits for it
+		g_jobs.submit(&group, JOB_PRIO_LOW, [] () {});
+		g_jobs.shutdown();
+		
+		bool ok = g_jobs.queued == 0 && g_jobs.worker_count == 0 && !g_jobs.queues;
+		g_jobs.init();
+		
+		std::atomic<u32> sum {0};
+		g_jobs.parallel_for<u32>(0, 100, 1, [&] (u32 b, u32 e) { sum += e -b; });
+		ok = ok && sum == 100 && g_jobs.queued == 0;
+		check(ok, "job system shutdown drops the queued jobs");
+	}
+	
+	{ // the chars of short lines are inline in the chunk, growing moves them into the pool, erasing or splitting them short again moves them back
+		Text_Pool pool;
+		Line_Text line(&pool);
+		
+		std::vector<utf32> expect;
+		for (u32 i=0; i<3 * Line_Text::INLINE_CHARS; ++i) expect.push_back(U'a' +i % 26);
+		
+		auto text_is = [&] (Line_Text cr l, std::vector<utf32> cr chars) {
+			std::vector<utf32> text((uptr)l.size());
+			l.copy_to(text.data());
+			return text == chars;
+		};
+		auto any_freed = [&] () {
+			for (auto* f : pool.free_lists) if (f) return true;
+			return false;
+		};
+		
+		line.insert(0, expect.data(), Line_Text::INLINE_CHARS);
+		bool ok = line.chunks[0].text.is_inline() && !any_freed();
+		line.insert(line.size(), expect.data() +Line_Text::INLINE_CHARS, (indx_t)expect.size() -Line_Text::INLINE_CHARS);
+		ok = ok && !line.chunks[0].text.is_inline() && text_is(line, expect);
+		
+		line.erase(2, (indx_t)expect.size() -4);
+		expect.erase(expect.begin() +2, expect.end() -4);
+		ok = ok && line.chunks[0].text.is_inline() && any_freed() && text_is(line, expect);
+		
+		line.insert(3, expect.data(), (indx_t)expect.size()); // into the pool again
+		expect.insert(expect.begin() +3, expect.begin(), expect.end());
+		ok = ok && !line.chunks[0].text.is_inline() && text_is(line, expect);
+		
+		auto tail = line.split_off(4);
+		ok = ok && line.chunks[0].text.is_inline() && text_is(line, std::vector<utf32>(expect.begin(), expect.begin() +4));
+		ok = ok && text_is(tail, std::vector<utf32>(expect.begin() +4, expect.end()));
+		check(ok, "line chars move from inline to the pool and back");
+		
+		line.release();
+		tail.release();
+	}
+	
+	{ // pastes of multiple lines (every newline kind, into odd and even lines) must land in the buffer byte for byte, and replaying the journal of them must too
+		static const char init[] = "first line\nsecond line\r\nthird\n";
+		static const char paste[] = "a\nb\r\nc\n\rd\re\n\n\xc3\xa4 f";
+		
+		cstr journal_file = "cedi-test";
+		remove(prints("%s.cedi-journal", journal_file).c_str());
+		
+		Journal_Header stamp = {};
+		stamp.file_size =		strlen(init);
+		stamp.content_hash =	Line_Index::content_hash(init, strlen(init));
+		
+		g_buf.init_from_str(init, strlen(init));
+		g_buf.open_journal(journal_file, stamp);
+		
+		std::string expect = init;
+		bool ok = true;
+		for (indx_t i=0; i<8; ++i) {
+			Text_Buffer::Cursor pos = { i % (indx_t)g_buf.lines.size(), 0 };
+			pos.c = min(i, g_buf.get_line(pos.l).get_newlineless_len());
+			
+			expect.insert(buffer_utf8(pos).size(), paste);
+			g_buf.insert_text(pos, paste, strlen(paste));
+			ok = ok && buffer_utf8() == expect;
+		}
+		check(ok, "paste of multiple lines matches the pasted bytes");
+		
+		g_buf.journal.close();
+		g_buf.init_from_str(init, strlen(init));
+		g_buf.open_journal(journal_file, stamp);
+		check(buffer_utf8() == expect, "journal replay of the pastes matches the pasted bytes");
+		
+		g_buf.journal.close();
+		remove(prints("%s.cedi-journal", journal_file).c_str());
+	}
+	
+	{ // folds are runs in a treap, every edit has to leave the same hidden lines as editing a plain hidden flag per line
+		Fold_Set folds;
+		std::vector<bool> model; // hidden flag of every line
+		
+		auto matches = [&] () {
+			bool ok = folds.line_count() == (indx_t)model.size();
+			indx_t row = 0;
+			for (indx_t l=0; l<(indx_t)model.size() && ok; ++l) {
+				ok = folds.is_hidden(l) == model[l] && folds.row_of_line(l) == row;
+				if (!model[l]) {
+					ok = ok && folds.line_of_row(row) == l && folds.row_of_line(folds.line_of_row(row)) == row;
+					++row;
+				}
+			}
+			return ok && folds.row_count() == row && folds.any_folded() == (row != (indx_t)model.size());
+		};
+		auto runs = [&] () { return (u32)(folds.nodes.size() -1 -folds.free_nodes.size()); };
+		auto set_hidden = [&] (indx_t b, indx_t e, bool hidden) {
+			for (indx_t l=b; l<e; ++l) model[l] = hidden;
+		};
+		
+		folds.reset(20);
+		model.assign(20, false);
+		
+		folds.fold(2, 5);			set_hidden(2, 5, true);
+		bool ok = matches() && runs() == 3;
+		folds.fold(10, 14);			set_hidden(10, 14, true);
+		ok = ok && matches() && runs() == 5;
+		ok = ok && folds.unfold(3) && !folds.unfold(7);
+		set_hidden(2, 5, false);
+		ok = ok && matches() && runs() == 3; // the visible runs around it got joined
+		folds.fold(2, 5);			set_hidden(2, 5, true);
+		check(ok && matches(), "folding and unfolding");
+		
+		folds.lines_inserted(3, 2);	model.insert(model.begin() +3, 2, true); // inside a fold, it grows
+		ok = matches();
+		folds.lines_inserted(2, 1);	model.insert(model.begin() +2, 1, false); // right after the header, visible
+		ok = ok && matches();
+		folds.lines_erased(4, 2);	model.erase(model.begin() +4, model.begin() +6); // part of the fold
+		ok = ok && matches();
+		folds.lines_erased(0, 1);	model.erase(model.begin()); // before everything
+		ok = ok && matches();
+		check(ok, "inserting and erasing lines in and around a fold");
+		
+		{ // erasing the lines between two folds, including the header of the second, joins them into one run
+			folds.reset(12);
+			model.assign(12, false);
+			folds.fold(2, 4);		set_hidden(2, 4, true);
+			folds.fold(7, 9);		set_hidden(7, 9, true);
+			ok = matches() && runs() == 5;
+			
+			folds.lines_erased(4, 3); model.erase(model.begin() +4, model.begin() +7); // lines 4,5 and the header 6
+			ok = ok && matches() && runs() == 3;
+			ok = ok && folds.unfold(5) && !folds.any_folded() && runs() == 1; // one unfold opens all of it
+			check(ok, "erasing the header between two folds joins them");
+		}
+		
+		{ // unfold_range opens only the lines inside the range
+			folds.reset(20);
+			model.assign(20, false);
+			folds.fold(2, 12);		set_hidden(2, 12, true);
+			ok = !folds.unfold_range(0, 2) && matches();
+			ok = ok && folds.unfold_range(5, 8);
+			set_hidden(5, 8, false);
+			ok = ok && matches() && runs() == 5;
+			ok = ok && folds.unfold_range(0, 20) && !folds.any_folded() && runs() == 1;
+			check(ok, "unfold_range opens only the lines inside the range");
+		}
+		
+		{ // appends while the last line is hidden get a visible run of their own, appends after a visible last line extend it
+			folds.reset(6);
+			model.assign(6, false);
+			folds.fold(3, 6);		set_hidden(3, 6, true);
+			folds.lines_appended(4);	model.insert(model.end(), 4, false);
+			ok = matches() && runs() == 3;
+			folds.lines_appended(2);	model.insert(model.end(), 2, false);
+			ok = ok && matches() && runs() == 3;
+			check(ok, "appending lines while the last line is hidden");
+		}
+	}
+	
+	{ // a paste into a folded region opens the fold, so the pasted lines and the cursor after them are not hidden
+		static const char init[] = "a {\n\tb\n\tc\n}\n";
+		g_buf.init_from_str(init, strlen(init));
+		g_buf.folds.fold(1, 3);
+		
+		auto end = g_buf.insert_text({ 2, 1 }, "x\ny", 3);
+		check(end.l == 3 && !g_buf.folds.is_hidden(end.l) && !g_buf.folds.any_folded(), "paste into a fold opens it");
+	}
+	
+	{ // appends (follow mode, streaming) split newline pairs and utf8 sequences anywhere, they have to end up like the text decoded at once
+		static const char text[] = "a\r\nb\n\rc\r\r\n\n\xc3\xa4\xe2\x82\xac\xf0\x9f\x98\x80 end";
+		
+		g_buf.init_from_str(text, strlen(text));
+		indx_t line_count = g_buf.lines.size();
+		
+		bool ok = true;
+		for (uptr piece=1; piece<=5; ++piece) {
+			g_buf.init_from_str(nullptr, 0);
+			
+			std::string held;
+			for (uptr i=0; i<strlen(text); i+=piece) {
+				held.append(text +i, min(piece, strlen(text) -i));
+				held.erase(0, (uptr)g_buf.append_bytes(held.data(), held.size(), false));
+				ok = ok && held.size() <= 3;
+			}
+			held.erase(0, (uptr)g_buf.append_bytes(held.data(), held.size(), true));
+			
+			ok = ok && held.empty() && buffer_utf8() == text && g_buf.lines.size() == line_count;
+		}
+		check(ok, "appending in pieces matches the text decoded at once");
+	}
+	
+	{ // a mapped file only gets decoded where it is viewed or edited, and edits across pages that are still mapped keep the text byte for byte
+		cstr path = "cedi-test.txt";
+		
+		std::string text;
+		std::vector<uptr> line_offs;
+		for (u32 i=0; i<100000; ++i) {
+			line_offs.push_back(text.size());
+			text += prints("line %u\n", i);
+		}
+		auto f = fopen(path, "wb");
+		if (f) {
+			fwrite(text.data(), 1, text.size(), f);
+			fclose(f);
+		}
+		
+		auto decoded_pages = [&] () {
+			u32 n = 0;
+			for (auto& pg : g_buf.lines.pages) n += pg.is_mapped() ? 0 : 1;
+			return n;
+		};
+		
+		bool ok = f && g_buf.init_mapped(path) && g_buf.lines.size() == 100001 && decoded_pages() == 0;
+		ok = ok && g_buf.get_line(5000).text.size() == 10 && decoded_pages() == 1;
+		check(ok, "a mapped file only decodes the page of the line that gets viewed");
+		
+		auto snap = g_buf.snapshot();
+		auto snap_text = text;
+		u32 mapped_pages = 0;
+		for (auto& pg : snap->pages) mapped_pages += pg->is_mapped() ? 1 : 0;
+		ok = decoded_pages() == 1 && mapped_pages == (u32)snap->pages.size() -1; // only the viewed page got copied
+		ok = ok && snapshot_utf8(*snap) == text;
+		check(ok, "a snapshot of a mapped file reads the lines that were not decoded from the mapping");
+		
+		g_buf.delete_range({ 100, 3 }, { 9000, 2 });
+		text.erase(line_offs[100] +3, line_offs[9000] +2 -(line_offs[100] +3));
+		
+		g_buf.insert_text({ 50000 -8900, 0 }, "x\ny", 3);
+		text.insert(line_offs[50000] -(line_offs[9000] +2 -(line_offs[100] +3)), "x\ny");
+		
+		ok = ok && decoded_pages() <= 3; // the pages at both ends of the deleted range and the one pasted into
+		ok = ok && buffer_utf8() == text;
+		check(ok, "edits between mapped pages match the edited bytes");
+		
+		auto after = g_buf.snapshot();
+		ok = snapshot_utf8(*after) == text && after->pages.back() == snap->pages.back(); // the last page did not change
+		after = nullptr;
+		g_buf.init_from_str(nullptr, 0); // unmaps the file once the snapshot is gone
+		ok = ok && snapshot_utf8(*snap) == snap_text;
+		check(ok, "snapshots of a mapped file share its unedited pages, and keep reading them after the buffer dropped it");
+		snap = nullptr;
+		
+		remove(path);
+		remove(prints("%s.cedi-index", path).c_str());
+	}
+	
+	{ // follow mode maps the appended bytes and extends the line index over them, the new lines only get decoded once they are viewed
+		cstr path = "cedi-test.txt";
+		auto append = [&] (cstr mode, std::string cr s) {
+			auto f = fopen(path, mode);
+			if (!f) return;
+			fwrite(s.data(), 1, s.size(), f);
+			fclose(f);
+		};
+		
+		std::string text = "first\r";
+		append("wb", text);
+		g_buf.open_file(path); // small, so it gets decoded
+		g_buf.start_follow();
+		
+		std::string big;
+		for (u32 i=0; i<10000; ++i) big += prints("appended %u\n", i);
+		
+		std::shared_ptr<Buffer_Snapshot const> snap; // of the mapped lines, taken before the file gets mapped again
+		std::string snap_text;
+		
+		bool ok = g_buf.following;
+		for (std::string s : { "\nsecond\n", "third \xe2\x82", "\xac line", "\n", big.c_str(), "last" }) { // splits a newline pair and a utf8 sequence
+			text += s;
+			append("ab", s);
+			g_buf.follow_changed = true;
+			g_buf.follow_update();
+			
+			auto expect = text.substr(0, (uptr)complete_utf8_len(text.data(), text.size()));
+			if (s == big) {
+				u32 decoded = 0;
+				for (auto& pg : g_buf.lines.pages) decoded += pg.is_mapped() ? 0 : 1;
+				ok = ok && decoded <= 2; // the lines that were there before and the last page
+				
+				snap = g_buf.snapshot();
+				snap_text = expect;
+			}
+			ok = ok && buffer_utf8() == expect;
+		}
+		ok = ok && snap && snapshot_utf8(*snap) == snap_text;
+		snap = nullptr;
+		check(ok, "follow mode appends exactly the new bytes and keeps them mapped");
+		
+		{ // without setting follow_changed, the watch (inotify, polling the file stamp on windows) has to notice the append
+			std::this_thread::sleep_for(std::chrono::milliseconds(200)); // the events of the appends above
+			g_buf.follow_changed = false;
+			
+			text += "\nwatched";
+			append("ab", "\nwatched");
+			for (u32 i=0; i<300 && !g_buf.follow_changed; ++i) std::this_thread::sleep_for(std::chrono::milliseconds(10));
+			
+			ok = g_buf.follow_changed;
+			g_buf.follow_update();
+			ok = ok && buffer_utf8() == text;
+			check(ok, "follow mode gets woken up by the file watch");
+		}
+		
+		g_buf.stop_follow();
+		g_buf.init_from_str(nullptr, 0); // unmaps the file
+		remove(path);
+		remove(prints("%s.cedi-journal", path).c_str());
+	}
+	
+	{ // a pipe reader that got abandoned while it was blocked in read must not append to the stream that replaced it
+		auto release = std::make_shared< std::atomic<bool> >(false);
+		auto returned = std::make_shared< std::atomic<bool> >(false);
+		
+		g_buf.start_stream([release, returned] (void* buf, uptr size) -> sptr {
+			while (!*release) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			memcpy(buf, "stale\n", 6);
+			*returned = true;
+			return 6;
+		}, true);
+		g_buf.stop_stream(); // not at eof, so the reader gets detached
+		
+		auto sent = std::make_shared<bool>(false);
+		g_buf.start_stream([sent] (void* buf, uptr size) -> sptr {
+			if (*sent) return 0;
+			*sent = true;
+			memcpy(buf, "fresh\n", 6);
+			return 6;
+		}, false);
+		
+		*release = true;
+		while (!*returned) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		std::this_thread::sleep_for(std::chrono::milliseconds(20)); // let the old reader finish
+		
+		while (g_buf.streaming) {
+			if (!g_buf.stream_update()) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		check(buffer_utf8() == "fresh\n", "an abandoned stream reader does not append to the next stream");
+	}
+	
+	#if CEDI_GZIP
+	{ // the first open of a gzip file streams it and saves its indices, opening it again only inflates the spans of the lines that get viewed
+		cstr path = "cedi-test.txt.gz";
+		
+		std::string text;
+		for (u32 i=0; i<400000; ++i) text += prints("line %u of the gzip test\n", i); // a few spans
+		
+		auto gz = gzopen(path, "wb");
+		if (gz) {
+			gzwrite(gz, UTF8_BOM, sizeof(UTF8_BOM));
+			gzwrite(gz, text.data(), (unsigned)text.size());
+			gzclose(gz);
+		}
+		
+		g_buf.open_file(path);
+		while (g_buf.streaming) {
+			if (!g_buf.stream_update()) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		bool ok = gz && buffer_utf8() == text;
+		check(ok, "streaming a gzip file skips the bom and matches its bytes");
+		
+		g_buf.open_file(path);
+		ok = ok && g_buf.mapped && g_buf.mapped->gz && g_buf.mapped->gz->index.checkpoints.size() > 1 && g_buf.lines.size() == 400001;
+		ok = ok && g_buf.get_line(300000).text.size() == 29 && g_buf.mapped->gz->cache.size() <= 2; // the first span got inflated to look for the bom
+		ok = ok && buffer_utf8() == text && snapshot_utf8(*g_buf.snapshot()) == text;
+		check(ok, "reopening an indexed gzip file inflates only the viewed spans");
+		
+		if (ok) { // every field of the sidecar that inflate_span() trusts
+			auto sidecar = prints("%s.cedi-gzindex", path);
+			auto& good = g_buf.mapped->gz->index;
+			
+			Gzip_Index::Sidecar_Header stamp = {};
+			get_file_stamp(path, &stamp.file_size, &stamp.file_mtime);
+			stamp.content_hash = Line_Index::content_hash((utf8 const*)g_buf.mapped->gz->in, g_buf.mapped->gz->in_len);
+			
+			ok = Gzip_Index().load_sidecar(sidecar.c_str(), stamp);
+			for (u32 i=0; i<5; ++i) {
+				Gzip_Index bad = good;
+				auto& cp = bad.checkpoints[1];
+				if (i == 0) cp.window_len = GZIP_WINDOW +1;
+				if (i == 1) cp.bits = 9;
+				if (i == 2) cp.in_pos = stamp.file_size +1;
+				if (i == 3) cp.in_pos = bad.checkpoints[0].in_pos -1;
+				if (i == 4) bad.total_out = (u64)1 << 60;
+				bad.save_sidecar(sidecar.c_str(), stamp);
+				ok = ok && !Gzip_Index().load_sidecar(sidecar.c_str(), stamp);
+			}
+			check(ok, "a corrupt gzip index gets rejected");
+		}
+		
+		g_buf.init_from_str(nullptr, 0); // unmaps the file
+		remove(path);
+		remove(prints("%s.cedi-gzindex", path).c_str());
+		remove(prints("%s.cedi-index", path).c_str());
+	}
+	#endif
+	
+	{ // the bracket highlight of the layout only searches the lines on screen until the index got built, ALT+B builds it
+		std::string text = "{\n";
+		for (u32 i=0; i<100000; ++i) text += i == 10 ? "(\n" : i == 20 ? ")\n" : "line\n";
+		text += "}\n";
+		g_buf.init_from_str(text.data(), text.size());
+		
+		Text_Buffer::Cursor m;
+		u32 unscanned = g_buf.brackets.unscanned;
+		bool ok = unscanned > Text_Buffer::LAYOUT_BRACKET_PAGES;
+		ok = ok && g_buf.find_visible_matching_bracket({ 11, 0 }, 0, 50, &m) && m.l == 21 && m.c == 0;
+		ok = ok && !g_buf.find_visible_matching_bracket({ 0, 0 }, 0, 50, &m) && g_buf.brackets.unscanned == unscanned;
+		check(ok, "the bracket highlight finds matches on screen without scanning the whole buffer");
+		
+		ok = g_buf.find_matching_bracket({ 0, 0 }, &m) && m.l == 100001 && g_buf.brackets.unscanned == 0;
+		g_buf.insert_text({ 5, 0 }, "x", 1);
+		ok = ok && g_buf.find_visible_matching_bracket({ 0, 0 }, 0, 50, &m) && m.l == 100001; // one page to rescan, uses the index
+		check(ok, "after the index got built the highlight finds matches anywhere");
+	}
+	
+	{ // find next runs on a snapshot, edits after it was taken don't change what it finds, and a search that finishes after an edit gets restarted
+		static const char init[] = "alpha beta\ngamma beta delta\n\tbeta\n";
+		g_buf.init_from_str(init, strlen(init));
+		
+		std::vector<utf32> query = { 'b','e','t','a' };
+		auto snap = g_buf.snapshot();
+		
+		g_buf.insert_text({ 1, 0 }, "beta ", 5); // not in the snapshot
+		
+		Text_Buffer::Cursor m;
+		bool ok = Text_Buffer::find_in_snapshot(*snap, query, { 0, 10 }, &m) && m.l == 1 && m.c == 6;
+		ok = ok && Text_Buffer::find_in_snapshot(*snap, query, { 2, 2 }, &m) && m.l == 0 && m.c == 6; // wraps around
+		check(ok, "find in a snapshot ignores later edits and wraps around");
+		
+		g_buf.cursor = { 0, 7 }; // on the first "beta"
+		g_buf.find_next();
+		g_buf.insert_char(U'x'); // edit while the search runs, if it finished already the version is stale too
+		for (u32 i=0; i<100 && g_buf.search; ++i) {
+			if (g_buf.search) g_jobs.wait(&g_buf.search->group);
+			g_buf.search_update();
+		}
+		ok = !g_buf.search && g_buf.select_cursor.l == 1 && g_buf.select_cursor.c == 0 && g_buf.cursor.c == 4; // the inserted "beta " at the start of line 1
+		check(ok, "find next restarts after an edit and selects the match");
+	}
+	
+	g_jobs.shutdown();
+	printf(failed ? "%u tests failed\n" : "all tests passed\n", failed);
+	return failed ? 1 : 0;
+}
+
 static void resize_wnd (iv2 dim) {
 	wnd_dim = dim;
 	g_buf.resize_sub_wnd(dim);
@@ -666,32 +2852,267 @@ static void resize_wnd (iv2 dim) {
 
 static void draw (cstr reason);
 static void init ();
+static void stop_render_thread ();
 
 #include "glfw_engine.hpp"
 
 
 ////
 static Shader_Text					shad_text;
-static Shader_Fullscreen_Tex_Copy	shad_text_copy;
 static Shader_Cursor_Pass			shad_cursor_pass;
 
 static VBO_Cursor_Pass		vbo_cursor;
 
-static RGBA_Framebuffer		fb_text;
+static RGBA_Framebuffer		fb_frame; // retained final image, only damaged rows get redrawn, then it gets blitted to the backbuffer
+
+// everything the render thread needs to draw one frame, written by the main thread, immutable once published (the render thread only adds its own scratch data to the arena)
+struct Render_Snapshot {
+	iv2										wnd_dim;
+	
+	std::shared_ptr<Text_Buffer::Glyph_Geometry>	glyphs; // only the slots that changed get uploaded
+	f32										scroll_offset_px;
+	Text_Buffer::Cursor_Box					cursor_box;
+	Arena_Array<Text_Buffer::Cursor_Box>	selection_boxes;
+	
+	f32										font_sdf_aa;
+	
+	u64										frame; // to detect dropped snapshots
+	bool									damage_all;
+	Arena_Array<Text_Buffer::Damage_Row>	damage;
+	
+	v3										col_background;
+	v3										col_text_highlighted;
+	v4										col_cursor;
+	v4										col_selection;
+	
+	bool									vsync;
+	u32										vsync_gen;
+	bool									continuous_drawing; // main thread wants to be woken up after this frame was presented to produce the next one
+	bool									print_stats;
+	
+	// transient data of this frame (boxes, damage, and the render threads vertices and scissor rects), reset when the main thread gets the slot back
+	Frame_Arena								arena;
+};
+
+// main thread does input and layout, render thread does all gl calls and presenting, so a slow frame does not delay key processing
+static Triple_Buffer<Render_Snapshot>	render_snapshots;
+static Thread_Signal					render_snapshot_published;
+static std::atomic<bool>				render_thread_quit {false};
+static std::thread						render_thread;
+
+// render thread only
+static u64							uploaded_glyphs_gen = 0;
+static u64							uploaded_glyph_slots_gen = 0;
+static u64							drawn_frame = 0;
+static f32							drawn_scroll_offset_px;
+
+struct Scissor_Rect {
+	s32 y0, y1; // gl window coords (bottom up), always the full window width
+};
+static void get_damaged_rects (Render_Snapshot cr s, bool full, Arena_Array<Scissor_Rect>* rects) {
+	
+	if (full) {
+		rects->push_back({ 0, s.wnd_dim.y });
+		return;
+	}
+	
+	for (auto& d : s.damage) {
+		// layout space (top down) -> window (bottom up)
+		s32 y0 = s.wnd_dim.y -(s32)ceil(d.y1 -s.scroll_offset_px);
+		s32 y1 = s.wnd_dim.y -(s32)floor(d.y0 -s.scroll_offset_px);
+		y0 = max(y0, 0);
+		y1 = min(y1, s.wnd_dim.y);
+		if (y1 > y0) rects->push_back({ y0, y1 });
+	}
+	
+	// merge overlapping rows, a cursor move usually damages the same row twice (line number and cursor box)
+	std::sort(rects->begin(), rects->end(), [] (Scissor_Rect cr l, Scissor_Rect cr r) { return l.y0 < r.y0; });
+	
+	u32 count = 0;
+	for (auto& r : *rects) {
+		if (count > 0 && r.y0 <= (*rects)[count -1].y1) {
+			(*rects)[count -1].y1 = max((*rects)[count -1].y1, r.y1);
+		} else {
+			(*rects)[count++] = r;
+		}
+	}
+	rects->resize(count);
+}
+
+static void push_box (VBO_Cursor_Pass::V** out, Text_Buffer::Cursor_Box cr box, v4 col) {
+	for (v2 quad_vert : { v2(1,0), v2(1,1), v2(0,0), v2(0,0), v2(1,1), v2(0,1) }) {
+		*(*out)++ = { box.pos +box.dim * quad_vert, col };
+	}
+}
+static u32 upload_cursor_verts (Render_Snapshot& s) { // selection boxes and cursor, all drawn with one draw call, returns the vertex count
+	u32 count = (s.selection_boxes.size() +1) * 6;
+	auto* verts = s.arena.alloc_array<VBO_Cursor_Pass::V>(count);
+	
+	auto* out = verts;
+	for (auto& box : s.selection_boxes) push_box(&out, box, s.col_selection);
+	push_box(&out, s.cursor_box, s.col_cursor); // after the selection, so that the cursor is on top
+	
+	vbo_cursor.upload(verts, count);
+	return count;
+}
+
+static void draw_snapshot (Render_Snapshot& s) {
+	gl_state.reset_counters();
+	
+	bool full = s.damage_all;
+	full = fb_frame.bind(s.wnd_dim) || full;
+	full = full || s.frame != drawn_frame +1; // the damage of a dropped snapshot was lost
+	full = full || s.scroll_offset_px != drawn_scroll_offset_px; // everything moved
+	
+	drawn_frame = s.frame;
+	drawn_scroll_offset_px = s.scroll_offset_px;
+	
+	Arena_Array<Scissor_Rect> scissor_rects;
+	scissor_rects.init(&s.arena);
+	get_damaged_rects(s, full, &scissor_rects);
+	
+	g_font.upload_pending_glyphs(); // glyphs that were used for the first time in this frame
+	
+	// while smooth scrolling the glyphs stay the same, only the scroll offset changes, edits and lines that enter the window only upload their slots
+	Arena_Array<GLint> slot_firsts;
+	Arena_Array<GLsizei> slot_counts;
+	slot_firsts.init(&s.arena);
+	slot_counts.init(&s.arena);
+	{
+		auto& g = *s.glyphs;
+		
+		bool all = g.slots_gen != uploaded_glyph_slots_gen;
+		if (all) g_font.vbo.alloc((u32)g.slots.size() * g.slot_cap);
+		
+		for (u32 i=0; i<(u32)g.slots.size(); ++i) {
+			auto& slot = g.slots[i];
+			if (slot.verts.size() == 0) continue;
+			
+			if (all || slot.gen > uploaded_glyphs_gen) g_font.vbo.upload_range(i * g.slot_cap, slot.verts.data(), (u32)slot.verts.size());
+			
+			slot_firsts.push_back( (GLint)(i * g.slot_cap) );
+			slot_counts.push_back( (GLsizei)slot.verts.size() );
+		}
+		
+		uploaded_glyphs_gen = g.gen;
+		uploaded_glyph_slots_gen = g.slots_gen;
+	}
+	
+	// uniforms are per program state, so they only need to be set once per frame and not for every damaged rect
+	shad_text.bind();
+	shad_text.wnd_dim.set( (v2)s.wnd_dim );
+	shad_text.scroll_offset.set( s.scroll_offset_px );
+	shad_text.sdf_aa.set( s.font_sdf_aa );
+	shad_text.col_highlighted.set( s.col_text_highlighted );
+	shad_text.bind_texture(g_font.tex);
+	
+	shad_cursor_pass.bind();
+	shad_cursor_pass.wnd_dim.set( (v2)s.wnd_dim );
+	shad_cursor_pass.scroll_offset.set( s.scroll_offset_px );
+	shad_cursor_pass.col_background.set( s.col_background );
+	
+	u32 cursor_vert_count = upload_cursor_verts(s);
+	
+	// everything is drawn directly into the retained frame in one pass per damaged rect, no intermediate text framebuffer
+	//  the boxes mark their pixels in the stencil buffer, the text gets drawn twice, once with the normal colors outside of the boxes and once with col_highlighted inside
+	//  the second draw only costs vertex work and stencil rejects, instead of full screen passes over the text framebuffer
+	glEnable(GL_SCISSOR_TEST);
+	glEnable(GL_STENCIL_TEST);
+	gl_state.count(2);
+	
+	for (auto& r : scissor_rects) {
+		glScissor(0, r.y0, s.wnd_dim.x, r.y1 -r.y0);
+		gl_state.count();
+		
+		clear_framebuffer(v4(s.col_background,0), true);
+		
+		{ // cursor and selection boxes
+			gl_state.stencil_func(GL_ALWAYS, 1);
+			
+			shad_cursor_pass.bind();
+			vbo_cursor.bind();
+			
+			gl_state.draw_triangles(cursor_vert_count);
+		}
+		{ // text
+			shad_text.bind();
+			
+			gl_state.stencil_func(GL_EQUAL, 0);
+			shad_text.highlighted.set(0);
+			g_font.draw_glyph_slots(slot_firsts.data, slot_counts.data, slot_counts.size());
+			
+			gl_state.stencil_func(GL_EQUAL, 1);
+			shad_text.highlighted.set(1);
+			g_font.draw_glyph_slots(slot_firsts.data, slot_counts.data, slot_counts.size());
+		}
+	}
+	
+	glDisable(GL_STENCIL_TEST);
+	glDisable(GL_SCISSOR_TEST);
+	gl_state.count(2);
+	
+	fb_frame.blit_to_backbuffer(); // the backbuffer is undefined after presenting, so always copy the whole retained frame
+	
+	if (s.print_stats) {
+		printf("render: %u damaged rects, %u gl calls (%u redundant binds skipped)\n",
+				(u32)scissor_rects.size(), gl_state.calls, gl_state.skipped);
+	}
+}
+
+static void render_thread_proc () {
+	glfwMakeContextCurrent(wnd);
+	
+	u32 vsync_gen = (u32)-1;
+	
+	for (;;) {
+		render_snapshot_published.wait();
+		if (render_thread_quit) break;
+		
+		auto* s = render_snapshots.read_latest();
+		if (!s) continue; // already drew the latest snapshot
+		
+		if (s->vsync_gen != vsync_gen) { // swap interval can only be set by the thread that has the context
+			glfwSwapInterval(s->vsync ? 1 : 0);
+			vsync_gen = s->vsync_gen;
+		}
+		
+		draw_snapshot(*s);
+		
+		platform_present_frame();
+		
+		if (s->continuous_drawing) glfwPostEmptyEvent(); // wake up main thread, so that smooth scrolling is paced by presenting (vsync)
+	}
+	
+	glfwMakeContextCurrent(NULL);
+}
+
+static void start_render_thread () {
+	glfwMakeContextCurrent(NULL); // all gl calls from now on happen on the render thread
+	render_thread = std::thread(render_thread_proc);
+}
+static void stop_render_thread () {
+	render_thread_quit = true;
+	render_snapshot_published.signal();
+	render_thread.join();
+}
 
 static void init  () {
-	g_font.init("consola.ttf");
+	f64 t_init_start = glfwGetTime();
+	
+	g_jobs.init();
+	
+	g_font.init();
 	
 	shad_text			.init();
-	shad_text_copy		.init();
 	shad_cursor_pass	.init();
 	
 	vbo_cursor			.init();
 	
-	fb_text				.init();
+	fb_frame			.init(GL_SRGB8_ALPHA8, true); // srgb like the backbuffer, with GL_FRAMEBUFFER_SRGB the blit then copies the encoded values unchanged
 	
 	//g_buf.open_file("src/cedi.cpp");
-	g_buf.open_file("build.bat");
+	if (strcmp(g_open_filename, "-") == 0)	g_buf.open_stdin();
+	else									g_buf.open_file(g_open_filename);
 	
 	{ // show window
 		auto mr = get_monitor_rect();
@@ -713,90 +3134,78 @@ static void init  () {
 		glfwSetWindowTitle(wnd, u8"cedi");
 	}
 	
+	{ // resize events only get queued, so make sure wnd_dim is valid for the first frame
+		iv2 dim;
+		glfwGetFramebufferSize(wnd, &dim.x,&dim.y);
+		resize_wnd( max(dim, iv2(1)) );
+	}
+	apply_input_events();
+	
+	printf("init: %.1f ms\n", (glfwGetTime() -t_init_start) * 1000);
+	
+	start_render_thread();
+	
 	draw("init()");
 }
 
+static u64 frame_counter = 0;
+
 static void draw (cstr reason) { // DBG: reason we drew a new frame
+	// generates the layout for a new frame and hands it to the render thread
 	
 	f64 t_draw_start = glfwGetTime();
 	
-	printf("draw [%14s] dt %.1f ms\n", reason, dt * 1000);
+	printf("draw [%14s] dt %.1f ms input events %u\n", reason, dt * 1000, frame_input_events);
+	frame_input_events = 0;
+	
+	#if CHECK_IDLE_FRAME_ALLOCS
+	u64 heap_allocs_before = heap_allocs;
+	#endif
 	
 	bool started_smooth_scrolling = g_buf.smooth_scroll_update();
 	
-	g_buf.generate_layout();
+	auto& s = render_snapshots.write_slot();
+	s.arena.reset(); // the render thread is done with this slot, so everything from the last time it was used is dead
 	
-	{ // text pass
-		fb_text.bind_and_clear(wnd_dim, v4(0));
-		
-		shad_text.bind();
-		shad_text.wnd_dim.set( (v2)wnd_dim );
-		shad_text.bind_texture(g_font.tex);
-		
-		g_font.draw_emitted_glyphs(shad_text, &g_buf.vbo_char_vert_data);
-	}
+	g_buf.begin_frame(&s.arena);
+	g_buf.generate_layout();
 	
-	{ // draw cursor
-		bind_backbuffer(wnd_dim);
-		clear_framebuffer(v4(opt.col_background,0));
-		
-		//
-		shad_text_copy.bind();
-		shad_text_copy.bind_fb(fb_text);
-		shad_text_copy.wnd_dim.set( (v2)wnd_dim );
+	{
+		s.wnd_dim =					wnd_dim;
 		
-		glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+		s.glyphs =					g_buf.glyphs; // shared, the geometry is not modified while a snapshot references it
+		s.scroll_offset_px =		g_buf.scroll_offset_px;
+		s.font_sdf_aa =				g_font.get_sdf_aa();
 		
-		glDrawArrays(GL_TRIANGLES, 0, 6);
+		s.selection_boxes =			g_buf.selection_boxes; // already in the arena of this slot
+		s.cursor_box =				g_buf.cursor_box;
 		
-		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		s.frame =					++frame_counter;
+		s.damage_all =				g_buf.damage_all;
+		s.damage =					g_buf.damage;
+		g_buf.damage_all = false;
 		
-		//
-		shad_cursor_pass.bind();
-		shad_cursor_pass.bind_fb(fb_text);
-		shad_cursor_pass.wnd_dim.set( (v2)wnd_dim );
-		shad_cursor_pass.col_background.set( opt.col_background );
-		shad_cursor_pass.col_highlighted.set( opt.col_text_highlighted );
+		s.col_background =			opt.col_background;
+		s.col_text_highlighted =	opt.col_text_highlighted;
+		s.col_cursor =				opt.col_cursor;
+		s.col_selection =			opt.col_selection;
 		
-		for (auto box : g_buf.selection_boxes) {
-			
-			std::initializer_list<VBO_Cursor_Pass::V> data = {
-				{ box.pos +box.dim * v2(1,0), opt.col_selection },
-				{ box.pos +box.dim * v2(1,1), opt.col_selection },
-				{ box.pos +box.dim * v2(0,0), opt.col_selection },
-				{ box.pos +box.dim * v2(0,0), opt.col_selection },
-				{ box.pos +box.dim * v2(1,1), opt.col_selection },
-				{ box.pos +box.dim * v2(0,1), opt.col_selection },
-			};
-			
-			vbo_cursor.upload(data);
-			vbo_cursor.bind(shad_cursor_pass);
-			
-			glDrawArrays(GL_TRIANGLES, 0, data.size());
-		}
+		s.vsync =					opt.vsync;
+		s.vsync_gen =				vsync_gen;
+		s.continuous_drawing =		continuous_drawing;
+		s.print_stats =				opt.print_render_stats;
 		
-		{
-			auto& r = g_buf.cursor_box;
-			
-			std::initializer_list<VBO_Cursor_Pass::V> data = {
-				{ r.pos +r.dim * v2(1,0), opt.col_cursor },
-				{ r.pos +r.dim * v2(1,1), opt.col_cursor },
-				{ r.pos +r.dim * v2(0,0), opt.col_cursor },
-				{ r.pos +r.dim * v2(0,0), opt.col_cursor },
-				{ r.pos +r.dim * v2(1,1), opt.col_cursor },
-				{ r.pos +r.dim * v2(0,1), opt.col_cursor },
-			};
-			
-			vbo_cursor.upload(data);
-			vbo_cursor.bind(shad_cursor_pass);
-			
-			glDrawArrays(GL_TRIANGLES, 0, data.size());
+		#if CHECK_IDLE_FRAME_ALLOCS
+		// only idle frames, see CHECK_IDLE_FRAME_ALLOCS
+		if (!g_buf.layout_changed && !s.arena.grew) {
+			dbg_assert(heap_allocs == heap_allocs_before, "idle frame made %llu heap allocations", heap_allocs -heap_allocs_before);
 		}
+		#endif
 		
+		render_snapshots.publish();
+		render_snapshot_published.signal();
 	}
 	
-	platform_present_frame();
-	
 	{
 		f64 now = glfwGetTime();
 		if (started_smooth_scrolling) {
@@ -0,0 +1,283 @@
+
+// Folded regions of the buffer
+//  all lines are covered by a sequence of runs, each run is either all visible or all hidden (a folded region without its header line),
+//  the runs live in a treap ordered by position, nodes have no keys, the position of a run is the line count of everything left of it,
+//  every node knows the line count and visible line count of its subtree, so converting between lines and visible rows,
+//  and edits shifting all folds after them, only walk one path down from the root, O(log n) in the number of folds
+//  with nothing folded there is one run and all of this is trivial
+struct Fold_Set {
+	typedef buf_indx_t indx_t;
+	
+	struct Node {
+		u32		left, right; // 0 is null
+		u32		prio; // heap ordered, parents have higher prio
+		bool	hidden;
+		indx_t	len; // lines in this run, never 0
+		indx_t	sum_len; // lines in the subtree
+		indx_t	sum_vis; // visible lines in the subtree
+	};
+	std::vector<Node>	nodes; // [0] is the null node, all its sums are 0
+	std::vector<u32>	free_nodes;
+	u32					root = 0;
+	u32					rand_state = 0x9e3779b9;
+	
+	u32 alloc (indx_t len, bool hidden) {
+		rand_state ^= rand_state << 13; // xorshift32
+		rand_state ^= rand_state >> 17;
+		rand_state ^= rand_state << 5;
+		
+		Node n = { 0, 0, rand_state, hidden, len, 0, 0 };
+		u32 i;
+		if (free_nodes.size()) {
+			i = free_nodes.back();
+			free_nodes.pop_back();
+			nodes[i] = n;
+		} else {
+			i = (u32)nodes.size();
+			nodes.push_back(n);
+		}
+		update(i);
+		return i;
+	}
+	void free_tree (u32 t) {
+		if (!t) return;
+		free_tree(nodes[t].left);
+		free_tree(nodes[t].right);
+		free_nodes.push_back(t);
+	}
+	
+	void update (u32 t) {
+		auto& n = nodes[t];
+		n.sum_len = nodes[n.left].sum_len +n.len +nodes[n.right].sum_len;
+		n.sum_vis = nodes[n.left].sum_vis +(n.hidden ? 0 : n.len) +nodes[n.right].sum_vis;
+	}
+	
+	void split (u32 t, indx_t pos, u32* a, u32* b) { // a gets lines [0, pos), b the rest, a run containing pos gets cut in two
+		if (!t) {
+			*a = 0;
+			*b = 0;
+			return;
+		}
+		indx_t lsum = nodes[nodes[t].left].sum_len;
+		if (pos <= lsum) {
+			u32 l;
+			split(nodes[t].left, pos, a, &l);
+			nodes[t].left = l;
+			update(t);
+			*b = t;
+		} else if (pos >= lsum +nodes[t].len) {
+			u32 r;
+			split(nodes[t].right, pos -lsum -nodes[t].len, &r, b);
+			nodes[t].right = r;
+			update(t);
+			*a = t;
+		} else {
+			indx_t k = pos -lsum;
+			u32 r = alloc(nodes[t].len -k, nodes[t].hidden); // may move nodes
+			nodes[r].prio = nodes[t].prio; // takes over the right subtree of t, so it needs a prio at least as high
+			nodes[r].right = nodes[t].right;
+			nodes[t].right = 0;
+			nodes[t].len = k;
+			update(r);
+			update(t);
+			*a = t;
+			*b = r;
+		}
+	}
+	u32 merge (u32 a, u32 b) {
+		if (!a) return b;
+		if (!b) return a;
+		if (nodes[a].prio >= nodes[b].prio) {
+			nodes[a].right = merge(nodes[a].right, b);
+			update(a);
+			return a;
+		} else {
+			nodes[b].left = merge(a, nodes[b].left);
+			update(b);
+			return b;
+		}
+	}
+	
+	u32 find_run (u32 t, indx_t l, indx_t* run_first) const { // run containing line l in the subtree t
+		indx_t offs = 0;
+		for (;;) {
+			dbg_assert(t);
+			auto& n = nodes[t];
+			indx_t lsum = nodes[n.left].sum_len;
+			if (l < offs +lsum) {
+				t = n.left;
+			} else if (l < offs +lsum +n.len) {
+				*run_first = offs +lsum;
+				return t;
+			} else {
+				offs += lsum +n.len;
+				t = n.right;
+			}
+		}
+	}
+	u32 add_lines (u32 t, indx_t l, indx_t delta) { // grow or shrink the run containing line l, returns the new subtree root (the run gets dropped if it becomes empty)
+		indx_t lsum = nodes[nodes[t].left].sum_len;
+		if (l < lsum) {
+			u32 c = add_lines(nodes[t].left, l, delta);
+			nodes[t].left = c;
+		} else if (l >= lsum +nodes[t].len) {
+			u32 c = add_lines(nodes[t].right, l -lsum -nodes[t].len, delta);
+			nodes[t].right = c;
+		} else {
+			nodes[t].len += delta;
+			if (nodes[t].len == 0) {
+				u32 m = merge(nodes[t].left, nodes[t].right);
+				free_nodes.push_back(t);
+				return m;
+			}
+		}
+		update(t);
+		return t;
+	}
+	
+	//
+	void reset (indx_t line_count) { // all lines were replaced, nothing is folded
+		nodes.clear();
+		free_nodes.clear();
+		nodes.push_back(Node{}); // null
+		root = alloc(line_count, false);
+	}
+	
+	indx_t line_count () const {		return nodes[root].sum_len; }
+	indx_t row_count () const {			return nodes[root].sum_vis; }
+	bool any_folded () const {			return row_count() != line_count(); }
+	
+	bool is_hidden (indx_t l) const {
+		indx_t first;
+		return nodes[find_run(root, l, &first)].hidden;
+	}
+	indx_t row_of_line (indx_t l) const { // visible lines before line l, so for a hidden line the row after its fold header
+		u32 t = root;
+		indx_t row = 0;
+		indx_t offs = 0;
+		while (t) {
+			auto& n = nodes[t];
+			indx_t lsum = nodes[n.left].sum_len;
+			if (l < offs +lsum) {
+				t = n.left;
+			} else if (l < offs +lsum +n.len) {
+				return row +nodes[n.left].sum_vis +(n.hidden ? 0 : l -offs -lsum);
+			} else {
+				offs += lsum +n.len;
+				row += nodes[n.left].sum_vis +(n.hidden ? 0 : n.len);
+				t = n.right;
+			}
+		}
+		return row;
+	}
+	indx_t line_of_row (indx_t row) const { // row in [0, row_count())
+		u32 t = root;
+		indx_t offs = 0;
+		for (;;) {
+			dbg_assert(t);
+			auto& n = nodes[t];
+			indx_t lvis = nodes[n.left].sum_vis;
+			indx_t vis = n.hidden ? 0 : n.len;
+			if (row < lvis) {
+				t = n.left;
+			} else if (row < lvis +vis) {
+				return offs +nodes[n.left].sum_len +(row -lvis);
+			} else {
+				row -= lvis +vis;
+				offs += nodes[n.left].sum_len +n.len;
+				t = n.right;
+			}
+		}
+	}
+	
+	// edits, called like the Snapshot_Builder hooks
+	void line_inserted (indx_t l) { // new line at l, belongs to the run of the line before it (a line inserted after a fold header is visible)
+		lines_inserted(l, 1);
+	}
+	void lines_inserted (indx_t l, indx_t count) {
+		if (count <= 0) return;
+		root = add_lines(root, max(l -1, (indx_t)0), count);
+	}
+	void line_erased (indx_t l) {
+		lines_erased(l, 1);
+	}
+	void lines_erased (indx_t l, indx_t count) { // lines [l, l +count)
+		if (count <= 0) return;
+		
+		u32 a, m, c;
+		split(root, l +count, &m, &c);
+		split(m, l, &a, &m);
+		free_tree(m);
+		root = merge(a, c);
+		
+		join_runs_at(l);
+	}
+	void join_runs_at (indx_t l) { // the runs of line l-1 and l become one if both are hidden or both are visible
+		// if the lines between two folds got erased, the second fold lost its header, so it becomes part of the first
+		if (l <= 0 || l >= line_count()) return;
+		indx_t first_a, first_b;
+		u32 a = find_run(root, l -1, &first_a);
+		u32 b = find_run(root, l, &first_b);
+		if (a != b && nodes[a].hidden == nodes[b].hidden) {
+			replace_runs(first_a, first_b +nodes[b].len, nodes[a].hidden);
+		}
+	}
+	void lines_appended (indx_t count) {
+		if (count <= 0) return;
+		if (!is_hidden(line_count() -1))	root = add_lines(root, line_count() -1, count);
+		else								root = merge(root, alloc(count, false));
+	}
+	
+	// hide lines [b, e), folds inside of it get swallowed, folds touching it get joined
+	void fold (indx_t b, indx_t e) {
+		dbg_assert(b > 0 && b < e && e <= line_count()); // line b-1 is the header, it stays visible
+		
+		indx_t first;
+		if (e < line_count()) {
+			u32 next = find_run(root, e, &first);
+			if (nodes[next].hidden) e = first +nodes[next].len; // hidden run right after, its header is hidden now
+		}
+		replace_runs(b, e, true);
+	}
+	bool unfold (indx_t l) { // show the hidden run containing line l, false if l was not hidden
+		indx_t first;
+		u32 t = find_run(root, l, &first);
+		if (!nodes[t].hidden) return false;
+		
+		// join with the visible runs around it, so unfolding does not leave a trail of runs behind
+		indx_t b = first, e = first +nodes[t].len;
+		if (b > 0) {
+			u32 prev = find_run(root, b -1, &first);
+			if (!nodes[prev].hidden) b = first;
+		}
+		if (e < line_count()) {
+			u32 next = find_run(root, e, &first);
+			if (!nodes[next].hidden) e = first +nodes[next].len;
+		}
+		replace_runs(b, e, false);
+		return true;
+	}
+	
+	bool unfold_range (indx_t b, indx_t e) { // show all lines in [b, e), parts of folds outside of it stay folded, false if nothing was hidden
+		for (indx_t l=b;; ) {
+			if (l >= e) return false;
+			indx_t first;
+			u32 t = find_run(root, l, &first);
+			if (nodes[t].hidden) break;
+			l = first +nodes[t].len;
+		}
+		
+		replace_runs(b, e, false);
+		join_runs_at(e);
+		join_runs_at(b);
+		return true;
+	}
+	
+	void replace_runs (indx_t b, indx_t e, bool hidden) { // lines [b, e) become one run
+		u32 a, m, c;
+		split(root, e, &m, &c);
+		split(m, b, &a, &m);
+		free_tree(m);
+		root = merge(merge(a, alloc(e -b, hidden)), c);
+	}
+};
@@ -1,44 +1,67 @@
 
-#define STB_RECT_PACK_IMPLEMENTATION
-#include "stb_rect_pack.h"
 #define STB_TRUETYPE_IMPLEMENTATION
 #include "stb_truetype.h"
 
 namespace font {
 	
-	struct Glyph_Range {
-		cstr	override_fontname; // nullptr -> use user specified font else always use specified font
+	struct Glyph_Range { // codepoints that get rasterized at startup (and cached), all others get rasterized the first time they are drawn
+		utf32			first;
+		s32				count;
+		utf32 const*	list; // nullptr -> [first, first +count)
 		
-		stbtt_pack_range	pr;
+		Glyph_Range (utf32 first, utf32 last): first{first}, count{(s32)(last +1 -first)}, list{nullptr} {
 		
-		Glyph_Range (cstr override_font, f32 font_size, utf32 first, utf32 last): override_fontname{override_font}, pr{font_size, (int)first, nullptr, (int)(last +1 -first), nullptr} {
-			
 		}
-		Glyph_Range (cstr override_font, f32 font_size, std::initializer_list<utf32> l): override_fontname{override_font}, pr{font_size, 0, (int*)l.begin(), (int)l.size(), nullptr} {
-			
+		Glyph_Range (std::initializer_list<utf32> l): first{0}, count{(s32)l.size()}, list{l.begin()} {
+		
 		}
+		
+		utf32 operator[] (s32 i) const {		return list ? list[i] : first +(utf32)i; }
 	};
 	
 	static std::initializer_list<utf32> ger = { U'ß',U'Ä',U'Ö',U'Ü',U'ä',U'ö',U'ü' };
-	static std::initializer_list<utf32> jp_sym = { U'　',U'、',U'。',U'”',U'「',U'」' };
 	static std::initializer_list<utf32> ws_visual = { U'·',U'—',U'→' };
 	
 	f32 sz = 24; // 14 16 24
 	f32 jpsz = floor(sz * 1.75f);
 	
-	static std::initializer_list<Glyph_Range> ranges = {
-		{ nullptr,		sz,		U'\xfffd', U'\xfffd' }, // missing glyph placeholder, must be the zeroeth glyph
-		//{ "arial.ttf",	sz,		U'\0', U'\x1f' }, // control characters // does not work for some reason, even though FontForge shows that these glyphs exist at least in arial.ttf
-		{ nullptr,		sz,		ws_visual }, // whitespace visualizers
-		{ nullptr,		sz,		U' ', U'~' },
-		//{ nullptr,		sz,		U'\x0', U'\x7f' }, // all ascii
-		{ nullptr,		sz,		ger },
-		{ "meiryo.ttc",	jpsz,	U'\x3040', U'\x30ff' }, // hiragana +katakana +some jp puncuation
-		{ "meiryo.ttc",	jpsz,	jp_sym },
+	static std::initializer_list<Glyph_Range> preload_ranges = {
+		{ U'\xfffd', U'\xfffd' }, // missing glyph placeholder, must be the zeroeth glyph
+		//{ U'\0', U'\x1f' }, // control characters // does not work for some reason, even though FontForge shows that these glyphs exist at least in arial.ttf
+		{ ws_visual }, // whitespace visualizers
+		{ U' ', U'~' },
+		//{ U'\x0', U'\x7f' }, // all ascii
+		{ ger },
+		// hiragana, katakana, jp puncuation etc. get rasterized from the fallback font on first use
 	};
 	
-	static u32 texw = 512; // hopefully large enough for now, if not 
-	static u32 texh = 512;
+	#if RZ_PLATF == RZ_PLATF_GENERIC_WIN
+	static std::initializer_list<cstr> font_dirs = { "c:/windows/fonts/" };
+	
+	static cstr latin_font =	"consola.ttf";
+	static cstr jp_font =		"meiryo.ttc";
+	#elif RZ_PLATF == RZ_PLATF_GENERIC_UNIX
+	static std::initializer_list<cstr> font_dirs = { "/usr/share/fonts/", "/usr/local/share/fonts/", "~/.local/share/fonts/", "~/.fonts/" }; // searched recursively
+	
+	static cstr latin_font =	"DejaVuSansMono.ttf";
+	static cstr jp_font =		"NotoSansCJK-Regular.ttc";
+	#endif
+	
+	// sdf atlas: glyphs are stored as signed distance fields (generated at sz), one atlas serves all zoom levels, zooming is just a different quad size and antialiasing width
+	// bitmap atlas: glyphs are rasterized coverage at exactly sz, slightly sharper, but can't be zoomed
+	static bool sdf_atlas = true;
+	
+	static s32 sdf_padding =			4; // px (at atlas size) the distance field extends outside of the glyph outline
+	static u8 sdf_onedge =				128;
+	static f32 sdf_pixel_dist_scale =	(f32)sdf_onedge / (f32)sdf_padding; // distance field value change per px
+	
+	static f32 min_zoom = 0.25f;
+	static f32 max_zoom = 8;
+	
+	static u32 texw = 1024; // hopefully large enough for now, if not glyphs that don't fit anymore are drawn as the missing glyph
+	static u32 texh = 1024;
+	
+	static cstr atlas_cache_filename =	"glyph_atlas.cache"; // in the working directory
 	
 	static constexpr v2 QUAD_VERTS[] = {
 		v2(1,0), // MSVC claims this is not a constexpr when i put this arr into the Font struct, but it worked before ???
@@ -49,12 +72,130 @@ namespace font {
 		v2(0,1),
 	};
 	
+	static u32 read_be16 (byte const* p) {	return ((u32)p[0] << 8) | (u32)p[1]; }
+	static u32 read_be32 (byte const* p) {	return ((u32)p[0] << 24) | ((u32)p[1] << 16) | ((u32)p[2] << 8) | (u32)p[3]; }
+	
+	// One font file of the fallback chain, only mapped once a codepoint needs it
+	struct Font_File {
+		cstr				filename;
+		f32					size; // px, glyphs of this font get rasterized at this height
+		
+		std::string			path; // empty if not found
+		bool				load_tried;
+		bool				loaded;
+		Mapped_File			file; // mapped, so only the pages of glyphs that actually get rasterized are read from disk
+		stbtt_fontinfo		info;
+		f32					scale;
+		
+		std::vector<u64>	coverage; // 1 bit per codepoint of the BMP, set if the cmap maps it to a glyph
+		
+		bool covers (utf32 c) const {
+			return c <= 0xffff && (coverage[c >> 6] & ((u64)1 << (c & 63))) != 0;
+		}
+		
+		bool load () {
+			if (load_tried) return loaded;
+			load_tried = true;
+			
+			if (path.empty() || !map_file(path.c_str(), &file)) {
+				printf("Could not find font '%s'!\n", filename);
+				return false;
+			}
+			if (!stbtt_InitFont(&info, file.data, stbtt_GetFontOffsetForIndex(file.data, 0))) {
+				printf("Could not load font '%s'!\n", path.c_str());
+				unmap_file(&file);
+				return false;
+			}
+			scale = stbtt_ScaleForPixelHeight(&info, size);
+			
+			build_coverage();
+			
+			loaded = true;
+			return true;
+		}
+		
+		void build_coverage () { // only reads the cmap, not the glyph data
+			coverage.assign(0x10000 / 64, 0);
+			
+			auto set_range = [&] (u32 first, u32 last) {
+				for (u32 c=first; c<=min(last, (u32)0xffff); ++c) {
+					coverage[c >> 6] |= (u64)1 << (c & 63);
+				}
+			};
+			
+			byte const* cmap = info.data +info.index_map;
+			u32 format = read_be16(cmap);
+			
+			if (format == 4) { // segments of the BMP, some codepoints in the segments might still map to glyph 0, the glyph lookup checks that
+				u32 seg_count =		read_be16(cmap +6) / 2;
+				byte const* ends =		cmap +14;
+				byte const* starts =	ends +seg_count*2 +2;
+				
+				for (u32 i=0; i<seg_count; ++i) {
+					u32 first = read_be16(starts +i*2);
+					u32 last = read_be16(ends +i*2);
+					if (first == 0xffff) continue; // terminator segment
+					set_range(first, last);
+				}
+			} else if (format == 12 || format == 13) { // groups of the full unicode range
+				u32 group_count = read_be32(cmap +12);
+				for (u32 i=0; i<group_count; ++i) {
+					byte const* g = cmap +16 +i*12;
+					u32 first = read_be32(g +0);
+					u32 last = read_be32(g +4);
+					if (first > 0xffff) continue;
+					set_range(first, last);
+				}
+			} else { // rare formats, ask stbtt for every codepoint
+				for (u32 c=0; c<=0xffff; ++c) {
+					if (stbtt_FindGlyphIndex(&info, (s32)c)) set_range(c, c);
+				}
+			}
+		}
+	};
+	
+	struct Shelf_Packer { // glyphs are placed left to right in rows (shelves), glyphs never get removed, so this is all that is needed
+		s32		w, h;
+		s32		x, y; // next free position on the current shelf
+		s32		shelf_h;
+		
+		bool pack (s32 rect_w, s32 rect_h, s32* out_x, s32* out_y) {
+			if (rect_w > w) return false;
+			if ((x +rect_w) > w) { // start new shelf
+				y += shelf_h;
+				x = 0;
+				shelf_h = 0;
+			}
+			if ((y +rect_h) > h) return false; // atlas full
+			
+			*out_x = x;
+			*out_y = y;
+			
+			x += rect_w;
+			shelf_h = max(shelf_h, rect_h);
+			return true;
+		}
+	};
+	
+	struct Atlas_Rect {
+		s32 x, y, w, h;
+	};
+	
 	struct Font {
 		Texture					tex;
 		VBO_Text			vbo;
 		
-		u32						glyphs_count;
-		stbtt_packedchar*		glyphs_packed_chars;
+		std::vector<Font_File>			fonts; // fallback chain, the first font that has a glyph for a codepoint is used
+		
+		std::vector<stbtt_packedchar>	glyphs_packed_chars;
+		std::vector<utf32>				glyph_codepoints; // codepoint of each glyph, to rebuild glyph_lookup from the cache
+		std::vector<s32>				glyph_lookup; // BMP codepoint -> glyph index, -1 if not rasterized yet, codepoints outside the BMP are drawn as the missing glyph
+		
+		Shelf_Packer					packer;
+		
+		// glyphs that get rasterized during layout (main thread) are uploaded by the render thread before it draws
+		std::mutex						uploads_mutex;
+		std::vector<Atlas_Rect>			pending_uploads;
 		
 		f32 border_left;
 		
@@ -63,153 +204,426 @@ namespace font {
 		
 		f32 line_height;
 		
-		bool init (cstr latin_filename) {
+		f32 char_w; // advance of ' ', layout assumes monospace for columns (horizontal scrolling)
+		
+		// metrics at sz, the ones above are for the current zoom
+		f32 base_ascent;
+		f32 base_descent;
+		f32 base_line_gap;
+		
+		f32 zoom;
+		
+		void set_zoom (f32 z) { // only the sdf atlas can be zoomed, the layout needs to be regenerated after this
+			zoom = sdf_atlas ? min(max(z, min_zoom), max_zoom) : 1;
 			
-			vbo.init();
-			tex.alloc(texw, texh);
+			line_height = ceil((base_ascent -base_descent +base_line_gap) * zoom); // ceil, so that lines are always seperated by exactly n pixels (else lines would get rounded to a y pos, which would result in uneven spacing)
 			
-			cstr fonts_folder = "c:/windows/fonts/";
+			f32 ceiled_line_gap = line_height -(base_ascent -base_descent) * zoom;
 			
-			struct Loaded_Font_File {
-				cstr			filename;
-				std::vector<byte>		f;
-			};
+			ascent_plus_gap = +base_ascent * zoom +ceiled_line_gap/2;
+			descent_plus_gap = -base_descent * zoom +ceiled_line_gap/2;
 			
-			std::vector<Loaded_Font_File> loaded_files;
+			char_w = glyphs_packed_chars[ get_glyph(U' ') ].xadvance * zoom;
+		}
+		f32 get_sdf_aa () { // half width of the antialiased edge in distance field units (0-1), 0 for the bitmap atlas
+			if (!sdf_atlas) return 0;
+			return 0.5f * (sdf_pixel_dist_scale / 255) / zoom; // 1 window px is 1/zoom atlas px
+		}
+		
+		bool init (cstr latin_filename=latin_font) {
+			f64 t_start = glfwGetTime();
 			
-			stbtt_pack_context spc;
-			stbtt_PackBegin(&spc, tex.data, (s32)tex.w,(s32)tex.h, (s32)tex.w, 1, nullptr);
+			vbo.init();
 			
-			//stbtt_PackSetOversampling(&spc, 1,1);
+			fonts.resize(2);
+			fonts[0].filename = latin_filename;	fonts[0].size = sz;
+			fonts[1].filename = jp_font;		fonts[1].size = jpsz;
 			
-			glyphs_count = 0;
-			for (auto r : ranges) {
-				dbg_assert(r.pr.num_chars > 0);
-				glyphs_count += r.pr.num_chars;
-			}
-			glyphs_packed_chars =	(stbtt_packedchar*)malloc(	glyphs_count*sizeof(stbtt_packedchar) );
+			tex.alloc(texw, texh);
+			memset(tex.data, 0, tex.w*tex.h);
 			
-			u32 cur = 0;
+			packer = { (s32)tex.w, (s32)tex.h, 0,0, 0 };
 			
-			for (auto r : ranges) {
-				
-				cstr filename = r.override_fontname ? r.override_fontname : latin_filename;
-				
-				auto* font_file = lsearch(loaded_files, [&] (Loaded_Font_File* loaded) {
-						return strcmp(loaded->filename, filename) == 0;
-					} );
+			glyph_lookup.assign(0x10000, -1);
+			
+			bool cached = load_atlas_cache(); // also gets the font paths, so a cache hit does not search the font dirs
+			if (!cached) {
+				for (auto& f : fonts) {
+					find_font_file(f.filename, &f.path);
+				}
 				
-				auto filepath = prints("%s%s", fonts_folder, filename);
+				if (!fonts[0].load()) return false;
 				
-				if (!font_file) {
-					loaded_files.push_back({ filename }); font_file = &loaded_files.back();
+				{
+					s32 ascent, descent, line_gap;
+					stbtt_GetFontVMetrics(&fonts[0].info, &ascent, &descent, &line_gap);
 					
-					load_file(filepath.c_str(), &font_file->f);
+					s32 x0, x1, y0, y1;
+					stbtt_GetFontBoundingBox(&fonts[0].info, &x0, &y0, &x1, &y1);
 					
-					if (cur == 0) {
-						stbtt_fontinfo info;
-						dbg_assert( stbtt_InitFont(&info, &font_file->f[0], 0) );
-						
-						f32 scale = stbtt_ScaleForPixelHeight(&info, sz);
-						
-						s32 ascent, descent, line_gap;
-						stbtt_GetFontVMetrics(&info, &ascent, &descent, &line_gap);
-						
-						s32 x0, x1, y0, y1;
-						stbtt_GetFontBoundingBox(&info, &x0, &y0, &x1, &y1);
-						
-						//border_left = -x0*scale;
-						border_left = 0;
-						
-						line_height = ceil(ascent*scale -descent*scale +line_gap*scale); // ceil, so that lines are always seperated by exactly n pixels (else lines would get rounded to a y pos, which would result in uneven spacing)
-						
-						f32 ceiled_line_gap = line_height -(ascent*scale -descent*scale);
-						
-						ascent_plus_gap = +ascent*scale +ceiled_line_gap/2;
-						descent_plus_gap = -descent*scale +ceiled_line_gap/2;
-						
-						//printf(">>> %f %f %f %f\n", border_left, ascent_plus_gap, descent_plus_gap, line_height);
-						
-					}
+					//border_left = -x0*fonts[0].scale;
+					border_left = 0;
+					
+					base_ascent =	ascent * fonts[0].scale;
+					base_descent =	descent * fonts[0].scale;
+					base_line_gap =	line_gap * fonts[0].scale;
+					
+					//printf(">>> %f %f %f\n", base_ascent, base_descent, base_line_gap);
 				}
 				
-				r.pr.chardata_for_range = &glyphs_packed_chars[cur];
-				cur += r.pr.num_chars;
+				get_glyph(U'\xfffd');
+				if (glyphs_packed_chars.size() == 0) { // no font has a missing glyph placeholder, but the zeroeth glyph needs to exist
+					glyphs_packed_chars.push_back({});
+					glyph_codepoints.push_back(U'\xfffd');
+					glyph_lookup[0xfffd] = 0;
+				}
 				
-				dbg_assert( stbtt_PackFontRanges(&spc, &font_file->f[0], 0, &r.pr, 1) > 0);
+				for (auto r : preload_ranges) {
+					for (s32 i=0; i<r.count; ++i) {
+						get_glyph(r[i]);
+					}
+				}
 				
+				save_atlas_cache(get_atlas_cache_key());
 			}
 			
-			stbtt_PackEnd(&spc);
+			set_zoom(1);
 			
-			tex.inplace_vertical_flip(); // TODO: could get rid of this simply by flipping the uv's of the texture
-			
-			glBindTexture(GL_TEXTURE_2D, tex.gl);
+			gl_state.bind_texture(0, tex.gl);
 			glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, tex.w,tex.h, 0, GL_RED, GL_UNSIGNED_BYTE, tex.data);
+			pending_uploads.clear(); // already part of the full upload
 			
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL,	0);
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL,	0);
 			
+			if (sdf_atlas) { // distance fields need to be interpolated
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,	GL_LINEAR);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER,	GL_LINEAR);
+			}
+			
 			//glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,	GL_LINEAR_MIPMAP_LINEAR);
 			//glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER,	GL_LINEAR);
 			
+			printf("font init: %.1f ms (%s)\n", (glfwGetTime() -t_start) * 1000,
+					cached ? "mapped glyph atlas cache" : "rasterized glyph atlas, wrote cache");
 			return true;
 		}
 		
-		static int search_glyph (utf32 c) {
-			int cur = 0;
-			for (auto r : ranges) {
-				if (r.pr.array_of_unicode_codepoints) {
-					for (int i=0; i<r.pr.num_chars; ++i) {
-						if (c == (utf32)r.pr.array_of_unicode_codepoints[i]) return cur; // found
-						++cur;
+		static bool find_font_file (cstr filename, std::string* path) {
+			for (cstr dir : font_dirs) {
+				std::string d = dir;
+				if (d[0] == '~') {
+					cstr home = getenv("HOME");
+					if (!home) continue;
+					d = home +d.substr(1);
+				}
+				if (find_file_in_dir_tree(d.c_str(), filename, path)) return true;
+			}
+			return false;
+		}
+		
+		// glyph lookup
+		s32 get_glyph (utf32 c) { // glyph index for c, rasterizes the glyph on first use, 0 (missing glyph) if no font has it
+			if (c > 0xffff) return 0;
+			
+			s32& g = glyph_lookup[c];
+			if (g < 0) {
+				g = add_glyph(c);
+			}
+			return g;
+		}
+		
+		s32 add_glyph (utf32 c) {
+			for (auto& f : fonts) {
+				if (!f.load() || !f.covers(c)) continue;
+				
+				s32 glyph = stbtt_FindGlyphIndex(&f.info, (s32)c);
+				if (glyph == 0) continue; // coverage is only exact to the cmap segment
+				
+				return rasterize_glyph(f, glyph, c);
+			}
+			return 0;
+		}
+		
+		s32 rasterize_glyph (Font_File& f, s32 glyph, utf32 c) { // rasterize into the atlas and queue the texture upload
+			stbtt_packedchar pc = {};
+			
+			s32 w=0, h=0, xoff=0, yoff=0;
+			u8* sdf = nullptr;
+			defer { if (sdf) stbtt_FreeSDF(sdf, nullptr); };
+			
+			if (sdf_atlas) {
+				sdf = stbtt_GetGlyphSDF(&f.info, f.scale, glyph, sdf_padding, sdf_onedge, sdf_pixel_dist_scale, &w,&h, &xoff,&yoff);
+				if (!sdf) { // glyph without outline (space)
+					w = 0; h = 0;
+					xoff = 0; yoff = 0;
+				}
+			} else {
+				s32 x0, y0, x1, y1;
+				stbtt_GetGlyphBitmapBox(&f.info, glyph, f.scale,f.scale, &x0,&y0, &x1,&y1);
+				w = x1 -x0;
+				h = y1 -y0;
+				xoff = x0;
+				yoff = y0;
+			}
+			
+			if (w > 0 && h > 0) {
+				s32 x, y;
+				if (!packer.pack(w +1, h +1, &x,&y)) { // +1 px gap, so that linear filtering does not bleed into neighbours
+					printf("Glyph atlas full, can't add U+%04x!\n", c);
+					return 0;
+				}
+				
+				if (sdf_atlas) {
+					for (s32 row=0; row<h; ++row) {
+						memcpy(&tex[y +row][x], &sdf[row*w], w);
 					}
 				} else {
-					auto first = (utf32)r.pr.first_unicode_codepoint_in_range;
-					if (c >= first && (c -first) < (u32)r.pr.num_chars) return cur +(c -first); // found
-					cur += (u32)r.pr.num_chars;
+					stbtt_MakeGlyphBitmap(&f.info, &tex[y][x], w,h, (s32)tex.w, f.scale,f.scale, glyph);
+				}
+				
+				{
+					std::lock_guard<std::mutex> lck(uploads_mutex);
+					pending_uploads.push_back({ x, y, w, h });
+				}
+				
+				pc.x0 = (unsigned short)x;
+				pc.y0 = (unsigned short)y;
+				pc.x1 = (unsigned short)(x +w);
+				pc.y1 = (unsigned short)(y +h);
+			}
+			
+			s32 advance, lsb;
+			stbtt_GetGlyphHMetrics(&f.info, glyph, &advance, &lsb);
+			
+			pc.xoff =		(f32)xoff;
+			pc.yoff =		(f32)yoff;
+			pc.xoff2 =		(f32)(xoff +w);
+			pc.yoff2 =		(f32)(yoff +h);
+			pc.xadvance =	(f32)advance * f.scale;
+			
+			glyphs_packed_chars.push_back(pc);
+			glyph_codepoints.push_back(c);
+			return (s32)glyphs_packed_chars.size() -1;
+		}
+		
+		void upload_pending_glyphs () { // render thread, before drawing
+			std::vector<Atlas_Rect> rects;
+			{
+				std::lock_guard<std::mutex> lck(uploads_mutex);
+				std::swap(rects, pending_uploads);
+			}
+			if (rects.size() == 0) return;
+			
+			gl_state.bind_texture(0, tex.gl);
+			
+			glPixelStorei(GL_UNPACK_ROW_LENGTH,		(s32)tex.w); // GL_UNPACK_ALIGNMENT is 1 for the whole program (set in main)
+			
+			// the main thread only ever writes to atlas pixels of new glyphs, so the rects of already queued glyphs can be read without locking
+			for (auto& r : rects) {
+				glPixelStorei(GL_UNPACK_SKIP_PIXELS,	r.x);
+				glPixelStorei(GL_UNPACK_SKIP_ROWS,		r.y);
+				glTexSubImage2D(GL_TEXTURE_2D, 0, r.x,r.y, r.w,r.h, GL_RED, GL_UNSIGNED_BYTE, tex.data);
+			}
+			
+			glPixelStorei(GL_UNPACK_SKIP_PIXELS,	0);
+			glPixelStorei(GL_UNPACK_SKIP_ROWS,		0);
+			glPixelStorei(GL_UNPACK_ROW_LENGTH,		0);
+			gl_state.count(4 +(u32)rects.size()*3);
+		}
+		
+		// glyph atlas cache
+		//  rasterizing (especially the sdf atlas) takes long and needs the font files to be read, so the preloaded atlas bitmap and glyph metrics get cached in a file
+		//  the key covers everything the atlas depends on, font files are identified by size and last write time, so a cache hit does not need to touch them
+		//  the resolved font paths are stored too, searching the font dirs (recursively on linux) is only needed on a miss,
+		//  a font that was missing when the cache was written stays missing until the cache gets deleted
+		//  glyphs that get rasterized lazily after startup are not cached
+		
+		static const u64 ATLAS_CACHE_MAGIC =	0x534c544149444543; // "CEDIATLS"
+		static const u32 ATLAS_CACHE_VERSION =	3; // increment when the rasterization or the file layout changes
+		
+		struct Atlas_Cache_Header {
+			u64		magic;
+			u64		key;
+			u32		font_paths_size; // multiple of 8, so the arrays after it stay aligned
+			u32		texw, texh;
+			u32		glyphs_count;
+			f32		border_left;
+			f32		base_ascent;
+			f32		base_descent;
+			f32		base_line_gap;
+			s32		packer_x, packer_y, packer_shelf_h;
+			// char				font_paths[font_paths_size]; // zero terminated path of every font of the fallback chain, empty if not found
+			// utf32			codepoints[glyphs_count];
+			// stbtt_packedchar	glyphs[glyphs_count];
+			// u8				tex[texh][texw];
+		};
+		
+		u64 get_atlas_cache_key () {
+			u64 h = hash_fnv1a(nullptr, 0);
+			
+			auto hash = [&] (void const* data, uptr size) {
+				h = hash_fnv1a(data, size, h);
+			};
+			auto hash_val = [&] (u64 val) {
+				hash(&val, sizeof(val));
+			};
+			
+			hash_val(ATLAS_CACHE_VERSION);
+			hash_val(sdf_atlas);
+			hash_val((u64)sdf_padding);
+			hash_val(sdf_onedge);
+			hash_val(texw);
+			hash_val(texh);
+			
+			for (auto& f : fonts) {
+				hash(f.filename, strlen(f.filename) +1);
+				hash(f.path.c_str(), f.path.size() +1);
+				hash(&f.size, sizeof(f.size));
+				
+				u64 size = 0, mtime = 0;
+				get_file_stamp(f.path.c_str(), &size, &mtime); // missing font -> 0, 0
+				hash_val(size);
+				hash_val(mtime);
+			}
+			
+			for (auto r : preload_ranges) {
+				for (s32 i=0; i<r.count; ++i) {
+					hash_val(r[i]);
 				}
 			}
+			return h;
+		}
+		
+		bool load_atlas_cache () {
+			Mapped_File f;
+			if (!map_file(atlas_cache_filename, &f)) return false;
+			defer { unmap_file(&f); };
+			
+			auto* hdr = (Atlas_Cache_Header const*)f.data;
+			
+			if (f.size < sizeof(Atlas_Cache_Header) || hdr->magic != ATLAS_CACHE_MAGIC ||
+					hdr->font_paths_size > f.size -sizeof(Atlas_Cache_Header) || hdr->texw != tex.w || hdr->texh != tex.h) {
+				return false;
+			}
+			
+			auto* paths = (char const*)(f.data +sizeof(Atlas_Cache_Header));
+			{
+				u32 pos = 0;
+				u32 found = 0;
+				for (auto& font : fonts) {
+					auto* end = (char const*)memchr(paths +pos, '\0', hdr->font_paths_size -pos);
+					if (!end) break;
+					
+					font.path = paths +pos;
+					pos = (u32)(end -paths) +1;
+					++found;
+				}
+				
+				if (found != fonts.size() || hdr->key != get_atlas_cache_key()) { // also misses if a font file changed or disappeared
+					for (auto& font : fonts) font.path.clear();
+					return false;
+				}
+			}
+			
+			u32 count = hdr->glyphs_count;
+			auto* codepoints =	(utf32 const*)(paths +hdr->font_paths_size);
+			auto* packedchars =	(stbtt_packedchar const*)(codepoints +count);
+			auto* pixels =		(u8 const*)(packedchars +count);
+			
+			if (f.size != (u64)(pixels -f.data) +(u64)tex.w*tex.h) return false;
+			
+			border_left =	hdr->border_left;
+			base_ascent =	hdr->base_ascent;
+			base_descent =	hdr->base_descent;
+			base_line_gap =	hdr->base_line_gap;
+			
+			packer.x =			hdr->packer_x;
+			packer.y =			hdr->packer_y;
+			packer.shelf_h =	hdr->packer_shelf_h;
+			
+			glyph_codepoints.assign(codepoints, codepoints +count);
+			glyphs_packed_chars.assign(packedchars, packedchars +count);
+			memcpy(tex.data, pixels, tex.w*tex.h); // copy, since lazily added glyphs get written to the atlas
+			
+			for (u32 i=0; i<count; ++i) {
+				if (codepoints[i] <= 0xffff) glyph_lookup[ codepoints[i] ] = (s32)i;
+			}
+			return true;
+		}
+		void save_atlas_cache (u64 key) {
+			auto f = fopen(atlas_cache_filename, "wb");
+			if (!f) {
+				printf("Could not write glyph atlas cache '%s'!\n", atlas_cache_filename);
+				return;
+			}
+			defer { fclose(f); };
+			
+			std::string paths;
+			for (auto& f : fonts) {
+				paths += f.path;
+				paths += '\0';
+			}
+			paths.resize((paths.size() +7) & ~(uptr)7, '\0');
 			
-			// This is probably a normal thing to happen, so no assert
-			//dbg_assert(false, "Glyph '%c' [%x] missing in font", c, c);
-			return 0; // missing glyph
+			Atlas_Cache_Header hdr = {};
+			hdr.magic =				ATLAS_CACHE_MAGIC;
+			hdr.key =				key;
+			hdr.font_paths_size =	(u32)paths.size();
+			hdr.texw =				tex.w;
+			hdr.texh =				tex.h;
+			hdr.glyphs_count =		(u32)glyphs_packed_chars.size();
+			hdr.border_left =		border_left;
+			hdr.base_ascent =		base_ascent;
+			hdr.base_descent =		base_descent;
+			hdr.base_line_gap =		base_line_gap;
+			hdr.packer_x =			packer.x;
+			hdr.packer_y =			packer.y;
+			hdr.packer_shelf_h =	packer.shelf_h;
+			
+			fwrite(&hdr, sizeof(hdr), 1, f);
+			fwrite(paths.data(), 1, paths.size(), f);
+			fwrite(&glyph_codepoints[0], sizeof(utf32), glyph_codepoints.size(), f);
+			fwrite(&glyphs_packed_chars[0], sizeof(stbtt_packedchar), glyphs_packed_chars.size(), f);
+			fwrite(tex.data, 1, tex.w*tex.h, f);
 		}
 		
 		f32 emit_glyph (std::vector<VBO_Text::V>* vbo_buf, f32 pos_x_px, f32 pos_y_px, utf32 c, v4 col) {
 			
 			stbtt_aligned_quad quad;
 			
-			stbtt_GetPackedQuad(glyphs_packed_chars, (s32)tex.w,(s32)tex.h, search_glyph(c),
-					&pos_x_px,&pos_y_px, &quad, 1);
+			if (!sdf_atlas) {
+				stbtt_GetPackedQuad(&glyphs_packed_chars[0], (s32)tex.w,(s32)tex.h, get_glyph(c),
+						&pos_x_px,&pos_y_px, &quad, 1);
+			} else { // sdf glyphs scale with zoom and don't need pixel alignment
+				auto& b = glyphs_packed_chars[ get_glyph(c) ];
+				
+				quad.x0 = pos_x_px +b.xoff * zoom;
+				quad.y0 = pos_y_px +b.yoff * zoom;
+				quad.x1 = pos_x_px +b.xoff2 * zoom;
+				quad.y1 = pos_y_px +b.yoff2 * zoom;
+				
+				quad.s0 = (f32)b.x0 / (f32)tex.w;
+				quad.t0 = (f32)b.y0 / (f32)tex.h;
+				quad.s1 = (f32)b.x1 / (f32)tex.w;
+				quad.t1 = (f32)b.y1 / (f32)tex.h;
+				
+				pos_x_px += b.xadvance * zoom;
+			}
 			
 			for (v2 quad_vert : QUAD_VERTS) {
 				vbo_buf->push_back({
 					/*pos*/ lerp(v2(quad.x0,quad.y0), v2(quad.x1,quad.y1), quad_vert),
-					/*uv*/ lerp(v2(quad.s0,-quad.t0), v2(quad.s1,-quad.t1), quad_vert),
+					/*uv*/ lerp(v2(quad.s0,quad.t0), v2(quad.s1,quad.t1), quad_vert),
 				/*col*/ col });
 			}
 			
 			return pos_x_px;
 		};
 		
-		void draw_emitted_glyphs (Shader_Text cr shad, std::vector<VBO_Text::V>* vbo_buf) {
-			
-			if (0) { // show texture
-				v2 left_bottom =	v2(wnd_dim.x -(f32)tex.w, (f32)tex.h);
-				v2 right_top =		v2(wnd_dim.x, 0);
-				for (v2 quad_vert : QUAD_VERTS) {
-					vbo_buf->push_back({
-						/*pos*/ lerp(left_bottom, right_top, quad_vert),
-						/*uv*/ quad_vert,
-						/*col*/ 1 });
-				}
-			}
-			
-			vbo.upload(*vbo_buf);
-			vbo.bind(shad);
-			
-			glDrawArrays(GL_TRIANGLES, 0, vbo_buf->size());
+		void draw_glyph_slots (GLint const* firsts, GLsizei const* counts, u32 slot_count) { // the slots of the text vbo that hold glyphs
+			vbo.bind();
+			gl_state.draw_triangles(firsts, counts, slot_count);
 		};
 		
 		#if 0
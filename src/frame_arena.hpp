@@ -0,0 +1,114 @@
+
+// Linear allocator for data that only lives for one frame, reset() frees everything at once in O(1)
+//  if a frame needs more than one block, reset() replaces the blocks with a single one of the high water mark, so after the first few frames it never touches the heap again
+//  only for trivially copyable types, nothing gets destructed
+struct Frame_Arena {
+	static const uptr MIN_BLOCK_SIZE = 64 * 1024;
+	
+	byte*				block =			nullptr;
+	uptr				block_size =	0;
+	uptr				used =			0; // in block
+	
+	std::vector<byte*>	full_blocks; // blocks that ran out during this frame, freed in reset()
+	uptr				frame_size =	0; // bytes allocated this frame, including the full blocks
+	bool				grew =			false; // had to allocate from the heap since the last reset()
+	
+	~Frame_Arena () {
+		free_full_blocks();
+		::free(block);
+	}
+	
+	void free_full_blocks () {
+		for (byte* b : full_blocks) ::free(b);
+		full_blocks.clear();
+	}
+	
+	void reset () {
+		if (full_blocks.size()) {
+			free_full_blocks();
+			::free(block);
+			
+			block_size = frame_size +frame_size / 2;
+			block = (byte*)::malloc(block_size);
+		}
+		used = 0;
+		frame_size = 0;
+		grew = false;
+	}
+	
+	void* alloc (uptr size, uptr align=16) { // align needs to be a power of two <= 16
+		uptr offs = (used +align -1) & ~(align -1);
+		if (!block || offs +size > block_size) {
+			if (block) full_blocks.push_back(block);
+			
+			block_size = max(max(block_size * 2, size), MIN_BLOCK_SIZE);
+			block = (byte*)::malloc(block_size);
+			grew = true;
+			
+			used = 0;
+			offs = 0; // malloc is 16 byte aligned on 64 bit
+		}
+		frame_size += (offs -used) +size;
+		used = offs +size;
+		return block +offs;
+	}
+	template <typename T>
+	T* alloc_array (uptr count) {
+		return (T*)alloc(count * sizeof(T), alignof(T));
+	}
+	
+	bool try_extend (void* p, uptr old_size, uptr new_size) { // grow the last allocation in place
+		if ((byte*)p +old_size != block +used || (byte*)p -block +new_size > block_size) return false;
+		frame_size += new_size -old_size;
+		used += new_size -old_size;
+		return true;
+	}
+};
+
+// growable array in a Frame_Arena, push_back grows in place if it was the last allocation, else it moves to a bigger copy (the old space is only freed by the arena reset)
+template <typename T>
+struct Arena_Array {
+	Frame_Arena*	arena =		nullptr;
+	T*				data =		nullptr;
+	u32				count =		0;
+	u32				capacity =	0;
+	
+	void init (Frame_Arena* arena) { // forget the contents, the arena needs to be reset by the owner
+		this->arena = arena;
+		data = nullptr;
+		count = 0;
+		capacity = 0;
+	}
+	
+	u32 size () const {			return count; }
+	T* begin () {				return data; }
+	T* end () {					return data +count; }
+	T const* begin () const {	return data; }
+	T const* end () const {		return data +count; }
+	T& operator[] (u32 i) {					dbg_assert(i < count); return data[i]; }
+	T const& operator[] (u32 i) const {		dbg_assert(i < count); return data[i]; }
+	
+	void push_back (T cr val) {
+		if (count == capacity) grow();
+		data[count++] = val;
+	}
+	void resize (u32 new_count) { // new elements are uninitialized
+		while (new_count > capacity) grow();
+		count = new_count;
+	}
+	void clear () {
+		count = 0;
+	}
+	
+	void grow () {
+		u32 new_capacity = max(capacity * 2, (u32)16);
+		if (data && arena->try_extend(data, capacity * sizeof(T), new_capacity * sizeof(T))) {
+			capacity = new_capacity;
+			return;
+		}
+		T* new_data = arena->alloc_array<T>(new_capacity);
+		if (count) memcpy(new_data, data, count * sizeof(T));
+		data = new_data;
+		capacity = new_capacity;
+	}
+};
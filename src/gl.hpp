@@ -12,6 +12,112 @@ STATIC_ASSERT(sizeof(GLsizeiptr) ==	sizeof(u64));
 #define GLSL_VERSION "#version 330\n"
 #endif
 
+// fixed attribute locations, bound for every shader before linking, so vaos can be set up once without knowing the shader
+enum Attrib_Loc : GLuint {
+	ATTRIB_POS =	0,
+	ATTRIB_UV =		1,
+	ATTRIB_COL =	2,
+};
+
+// Cache of the bound gl state, all binds go through here, so binding what is already bound gets skipped
+//  also counts the gl calls of a frame, to see how much driver overhead drawing has
+//  only knows about binds that went through it, and is only valid on the thread that currently owns the context
+struct GL_State {
+	static const GLuint UNKNOWN = (GLuint)-1;
+	static const u32 TEXTURE_UNITS = 4;
+	
+	GLuint	prog =			UNKNOWN;
+	GLuint	vao =			UNKNOWN;
+	GLuint	array_buffer =	UNKNOWN;
+	GLuint	framebuffer =	UNKNOWN;
+	GLuint	active_unit =	UNKNOWN;
+	GLuint	textures[TEXTURE_UNITS] = { UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN };
+	GLenum	blend_src =		UNKNOWN;
+	GLenum	blend_dst =		UNKNOWN;
+	GLenum	stencil_test =	UNKNOWN;
+	GLint	stencil_ref =	-1;
+	iv2		viewport_res =	iv2(-1);
+	
+	u32		calls =			0; // gl calls since reset_counters()
+	u32		skipped =		0; // redundant binds that were skipped since reset_counters()
+	
+	void reset_counters () {
+		calls = 0;
+		skipped = 0;
+	}
+	void count (u32 n=1) { // for gl calls that don't go through the cache
+		calls += n;
+	}
+	
+	void use_program (GLuint p) {
+		if (p == prog) { ++skipped; return; }
+		glUseProgram(p);
+		++calls;
+		prog = p;
+	}
+	void bind_vao (GLuint v) {
+		if (v == vao) { ++skipped; return; }
+		glBindVertexArray(v);
+		++calls;
+		vao = v;
+	}
+	void bind_array_buffer (GLuint b) {
+		if (b == array_buffer) { ++skipped; return; }
+		glBindBuffer(GL_ARRAY_BUFFER, b);
+		++calls;
+		array_buffer = b;
+	}
+	void bind_framebuffer (GLuint fb) {
+		if (fb == framebuffer) { ++skipped; return; }
+		glBindFramebuffer(GL_FRAMEBUFFER, fb);
+		++calls;
+		framebuffer = fb;
+	}
+	void bind_texture (GLuint unit, GLuint tex) {
+		dbg_assert(unit < TEXTURE_UNITS);
+		if (tex == textures[unit]) { ++skipped; return; }
+		if (unit != active_unit) {
+			glActiveTexture(GL_TEXTURE0 +unit);
+			++calls;
+			active_unit = unit;
+		}
+		glBindTexture(GL_TEXTURE_2D, tex);
+		++calls;
+		textures[unit] = tex;
+	}
+	void blend_func (GLenum src, GLenum dst) {
+		if (src == blend_src && dst == blend_dst) { ++skipped; return; }
+		glBlendFunc(src, dst);
+		++calls;
+		blend_src = src;
+		blend_dst = dst;
+	}
+	void stencil_func (GLenum func, GLint ref) {
+		if (func == stencil_test && ref == stencil_ref) { ++skipped; return; }
+		glStencilFunc(func, ref, 0xff);
+		++calls;
+		stencil_test = func;
+		stencil_ref = ref;
+	}
+	void viewport (iv2 res) {
+		if (res.x == viewport_res.x && res.y == viewport_res.y) { ++skipped; return; }
+		glViewport(0, 0, res.x, res.y);
+		++calls;
+		viewport_res = res;
+	}
+	
+	void draw_triangles (u32 vert_count) {
+		glDrawArrays(GL_TRIANGLES, 0, vert_count);
+		++calls;
+	}
+	void draw_triangles (GLint const* firsts, GLsizei const* counts, u32 range_count) { // several ranges of the bound vbo in one call
+		if (range_count == 0) return;
+		glMultiDrawArrays(GL_TRIANGLES, firsts, counts, range_count);
+		++calls;
+	}
+};
+static GL_State gl_state;
+
 struct Texture {
 	GLuint	gl;
 	u8*		data;
@@ -44,56 +150,89 @@ struct Texture {
 };
 
 static void bind_backbuffer (iv2 res) {
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	gl_state.bind_framebuffer(0);
 	
-	glViewport(0, 0, res.x, res.y);
+	gl_state.viewport(res);
 	
 }
-static void clear_framebuffer (v4 clear_col) {
+static void clear_framebuffer (v4 clear_col, bool stencil=false) { // stencil gets cleared to 0
 	glClearColor(clear_col.x, clear_col.y, clear_col.z, clear_col.w);
-	glClear(GL_COLOR_BUFFER_BIT);
+	glClear(GL_COLOR_BUFFER_BIT | (stencil ? GL_STENCIL_BUFFER_BIT : 0));
+	gl_state.count(2);
 }
 
 struct RGBA_Framebuffer {
 	GLuint	fb;
 	GLuint	tex;
+	GLuint	depth_stencil = 0; // 0 if no stencil buffer
+	GLenum	format;
+	iv2		res;
 	
-	void init () {
+	void init (GLenum format=GL_RGBA32F, bool stencil=false) { // GL_SRGB8_ALPHA8 for framebuffers that get blitted to the (srgb) backbuffer (blitting float to unorm is not allowed, linear 8 bit bands in the darks)
+		this->format = format;
+		res = iv2(0);
+		
 		glGenFramebuffers(1,	&fb);
 		glGenTextures(1,		&tex);
 		
-		glBindFramebuffer(GL_FRAMEBUFFER, fb);
+		gl_state.bind_framebuffer(fb);
 		
 		{
-			glBindTexture(GL_TEXTURE_2D, tex);
+			gl_state.bind_texture(0, tex);
 			
 			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, tex, 0);
 		}
-		
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		if (stencil) { // there is no portable stencil-only format, so it comes with an unused depth buffer
+			glGenRenderbuffers(1, &depth_stencil);
+			glBindRenderbuffer(GL_RENDERBUFFER, depth_stencil);
+			
+			glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depth_stencil);
+		}
 	}
 	
-	void bind_and_clear (iv2 res, v4 clear_col) {
-		glBindFramebuffer(GL_FRAMEBUFFER, fb);
-		
-		glBindTexture(GL_TEXTURE_2D, tex);
-		
-		// GL_RGBA32F
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, res.x,res.y,
-				0, GL_RGBA, GL_FLOAT, NULL);
-		
-		glTexParameteri(GL_TEXTURE_2D,	GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-		glTexParameteri(GL_TEXTURE_2D,	GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	bool bind (iv2 res) { // contents are retained between frames, returns true if the texture had to be reallocated (contents undefined)
+		gl_state.bind_framebuffer(fb);
 		
-		glTexParameteri(GL_TEXTURE_2D,	GL_TEXTURE_BASE_LEVEL, 0);
-		glTexParameteri(GL_TEXTURE_2D,	GL_TEXTURE_MAX_LEVEL, 0);
+		bool realloc = res.x != this->res.x || res.y != this->res.y;
+		if (realloc) {
+			this->res = res;
+			
+			gl_state.bind_texture(0, tex);
+			
+			glTexImage2D(GL_TEXTURE_2D, 0, format, res.x,res.y,
+					0, GL_RGBA, format == GL_RGBA8 || format == GL_SRGB8_ALPHA8 ? GL_UNSIGNED_BYTE : GL_FLOAT, NULL);
+			
+			glTexParameteri(GL_TEXTURE_2D,	GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D,	GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+			
+			glTexParameteri(GL_TEXTURE_2D,	GL_TEXTURE_BASE_LEVEL, 0);
+			glTexParameteri(GL_TEXTURE_2D,	GL_TEXTURE_MAX_LEVEL, 0);
+			gl_state.count(5);
+			
+			if (depth_stencil) {
+				glBindRenderbuffer(GL_RENDERBUFFER, depth_stencil);
+				glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, res.x,res.y);
+				gl_state.count(2);
+			}
+		}
 		
-		glBindTexture(GL_TEXTURE_2D, 0);
-		
-		glViewport(0, 0, res.x, res.y);
+		gl_state.viewport(res);
 		
+		return realloc;
+	}
+	void bind_and_clear (iv2 res, v4 clear_col) {
+		bind(res);
 		clear_framebuffer(clear_col);
+	}
+	
+	void blit_to_backbuffer () {
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, fb);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+		
+		glBlitFramebuffer(0,0, res.x,res.y, 0,0, res.x,res.y, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+		gl_state.count(3);
 		
+		gl_state.framebuffer = GL_State::UNKNOWN; // read and draw binding differ now
 	}
 };
 
@@ -102,11 +241,9 @@ static GLuint vbo_init_and_upload_static (void* data, uptr data_size) {
 	GLuint vbo;
 	glGenBuffers(1, &vbo);
 	
-	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	gl_state.bind_array_buffer(vbo);
 	glBufferData(GL_ARRAY_BUFFER, data_size, data, GL_STATIC_DRAW);
 	
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	
 	return vbo;
 }
 static bool shad_check_compile_status (GLuint shad) {
@@ -189,6 +326,10 @@ struct Basic_Shader {
 		shad_check_compile_status(frag);
 		glAttachShader(prog, frag);
 		
+		glBindAttribLocation(prog, ATTRIB_POS,	"attrib_pos"); // names the shader does not use are ignored
+		glBindAttribLocation(prog, ATTRIB_UV,	"attrib_uv");
+		glBindAttribLocation(prog, ATTRIB_COL,	"attrib_col");
+		
 		glLinkProgram(prog);
 		shad_check_link_status(prog);
 		
@@ -199,7 +340,7 @@ struct Basic_Shader {
 		glDeleteShader(frag);
 	}
 	void bind () {
-		glUseProgram(prog);
+		gl_state.use_program(prog);
 	}
 	
 };
@@ -208,47 +349,55 @@ struct Unif_s32 {
 	GLint loc;
 	void set (s32 i) const {
 		glUniform1i(loc, i);
+		gl_state.count();
 	}
 };
 struct Unif_flt {
 	GLint loc;
 	void set (f32 f) const {
 		glUniform1f(loc, f);
+		gl_state.count();
 	}
 };
 struct Unif_fv2 {
 	GLint loc;
 	void set (fv2 v) const {
 		glUniform2f(loc, v.x,v.y);
+		gl_state.count();
 	}
 };
 struct Unif_fv3 {
 	GLint loc;
 	void set (fv3 cr v) const {
 		glUniform3fv(loc, 1, &v.x);
+		gl_state.count();
 	}
 };
 struct Unif_fv4 {
 	GLint loc;
 	void set (fv4 cr v) const {
 		glUniform4fv(loc, 1, &v.x);
+		gl_state.count();
 	}
 };
 struct Unif_fm2 {
 	GLint loc;
 	void set (fm2 m) const {
 		glUniformMatrix2fv(loc, 1, GL_FALSE, &m.arr[0][0]);
+		gl_state.count();
 	}
 };
 struct Unif_fm4 {
 	GLint loc;
 	void set (fm4 m) const {
 		glUniformMatrix4fv(loc, 1, GL_FALSE, &m.arr[0][0]);
+		gl_state.count();
 	}
 };
 
 struct VBO_Text {
 	GLuint	vbo;
+	GLuint	vao; // attribute setup happens once in init(), binding the vao restores it
 	struct V {
 		v2	pos;
 		v2	uv;
@@ -257,37 +406,40 @@ struct VBO_Text {
 	
 	void init () {
 		glGenBuffers(1, &vbo);
+		glGenVertexArrays(1, &vao);
+		
+		gl_state.bind_vao(vao);
+		gl_state.bind_array_buffer(vbo);
+		
+		glEnableVertexAttribArray(ATTRIB_POS);
+		glVertexAttribPointer(ATTRIB_POS,	2, GL_FLOAT, GL_FALSE, sizeof(V), (void*)offsetof(V,pos));
+		
+		glEnableVertexAttribArray(ATTRIB_UV);
+		glVertexAttribPointer(ATTRIB_UV,	2, GL_FLOAT, GL_FALSE, sizeof(V), (void*)offsetof(V,uv));
+		
+		glEnableVertexAttribArray(ATTRIB_COL);
+		glVertexAttribPointer(ATTRIB_COL,	4, GL_FLOAT, GL_FALSE, sizeof(V), (void*)offsetof(V,col));
 	}
 	void upload (std::vector<V> cr data) {
 		uptr data_size = data.size() * sizeof(V);
 		
-		glBindBuffer(GL_ARRAY_BUFFER, vbo);
+		gl_state.bind_array_buffer(vbo);
 		glBufferData(GL_ARRAY_BUFFER, data_size, NULL, GL_STATIC_DRAW);
 		glBufferData(GL_ARRAY_BUFFER, data_size, data.data(), GL_STATIC_DRAW);
-		
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		gl_state.count(2);
 	}
-	void bind (Basic_Shader cr shad) {
-		
-		glBindBuffer(GL_ARRAY_BUFFER, vbo);
-		
-		GLint	pos =	glGetAttribLocation(shad.prog, "attrib_pos");
-		GLint	uv =	glGetAttribLocation(shad.prog, "attrib_uv");
-		GLint	col =	glGetAttribLocation(shad.prog, "attrib_col");
-		
-		dbg_assert(pos >= 0);
-		dbg_assert(uv >= 0);
-		dbg_assert(col >= 0);
-		
-		glEnableVertexAttribArray(pos);
-		glVertexAttribPointer(pos,	2, GL_FLOAT, GL_FALSE, sizeof(V), (void*)offsetof(V,pos));
-		
-		glEnableVertexAttribArray(uv);
-		glVertexAttribPointer(uv,	2, GL_FLOAT, GL_FALSE, sizeof(V), (void*)offsetof(V,uv));
-		
-		glEnableVertexAttribArray(col);
-		glVertexAttribPointer(col,	4, GL_FLOAT, GL_FALSE, sizeof(V), (void*)offsetof(V,col));
-		
+	void alloc (u32 count) { // contents undefined until upload_range()
+		gl_state.bind_array_buffer(vbo);
+		glBufferData(GL_ARRAY_BUFFER, count * sizeof(V), NULL, GL_DYNAMIC_DRAW);
+		gl_state.count();
+	}
+	void upload_range (u32 first, V const* data, u32 count) {
+		gl_state.bind_array_buffer(vbo);
+		glBufferSubData(GL_ARRAY_BUFFER, first * sizeof(V), count * sizeof(V), data);
+		gl_state.count();
+	}
+	void bind () {
+		gl_state.bind_vao(vao);
 	}
 	
 };
@@ -302,9 +454,11 @@ GLSL_VERSION R"_SHAD(
 	out		vec2	uv;
 	
 	uniform vec2	wnd_dim;
+	uniform float	scroll_offset; // px, layout is in layout space, which gets translated by the smooth scroll position here
 	
 	void main() {
 		vec2 tmp = attrib_pos;
+		tmp.y -= scroll_offset;
 		tmp.y = wnd_dim.y -tmp.y;
 		vec2 pos_clip = (tmp / wnd_dim) * 2 -1;
 		
@@ -318,17 +472,37 @@ GLSL_VERSION R"_SHAD(
 	in		vec4	color;
 	in		vec2	uv;
 	uniform	sampler2D	tex;
+	uniform	float		sdf_aa; // 0: tex is glyph coverage, else tex is a distance field (edge at 0.5) and this is the half width of the antialiased edge
+	uniform	int			highlighted; // 1: drawing the text inside the cursor and selection boxes (selected by the stencil test), which is drawn in col_highlighted
+	uniform	vec3		col_highlighted;
 	
-	out		vec4	frag_col;
+	out		vec4	frag_col; // premultiplied, blended with (ONE, ONE_MINUS_SRC_ALPHA) directly onto the background and boxes
 	
 	void main() {
-		frag_col = color * vec4(1,1,1, texture(tex, uv).r);
+		float a = texture(tex, uv).r;
+		if (sdf_aa > 0) {
+			a = smoothstep(0.5 -sdf_aa, 0.5 +sdf_aa, a);
+		}
+		a *= color.a;
+		
+		// text used to be drawn into its own framebuffer first (alpha blended, so the coverage got squared into its alpha) and then composited over the background
+		//  this reproduces that composite, highlighted text used pow(alpha, 1/3) of the text framebuffer to look bolder on the box colors
+		if (highlighted != 0) {
+			float ha = pow(a*a, 1.0/3);
+			frag_col = vec4(col_highlighted * ha, ha);
+		} else {
+			frag_col = vec4(color.rgb * a, a*a);
+		}
 	}
 )_SHAD"
 	) {}
 	
 	// uniforms
 	Unif_fv2	wnd_dim;
+	Unif_flt	scroll_offset;
+	Unif_flt	sdf_aa;
+	Unif_s32	highlighted;
+	Unif_fv3	col_highlighted;
 	
 	void init () {
 		compile();
@@ -336,67 +510,31 @@ GLSL_VERSION R"_SHAD(
 		wnd_dim.loc =		glGetUniformLocation(prog, "wnd_dim");
 		dbg_assert(wnd_dim.loc >= 0);
 		
-		auto tex = 			glGetUniformLocation(prog, "tex");
-		dbg_assert(tex >= 0);
-		glUniform1i(tex, 0);
-	}
-	void bind_texture (Texture tex) {
-		glActiveTexture(GL_TEXTURE0 +0);
-		glBindTexture(GL_TEXTURE_2D, tex.gl);
-	}
-};
-
-struct Shader_Fullscreen_Tex_Copy : Basic_Shader {
-	Shader_Fullscreen_Tex_Copy (): Basic_Shader(
-// Vertex shader
-GLSL_VERSION R"_SHAD(
-	void main() {
-		switch (gl_VertexID) {
-			case 0: gl_Position = vec4(-1,-1, 0,1); break;
-			case 1: gl_Position = vec4(+1,-1, 0,1); break;
-			case 2: gl_Position = vec4(-1,+1, 0,1); break;
-			case 3: gl_Position = vec4(-1,+1, 0,1); break;
-			case 4: gl_Position = vec4(+1,-1, 0,1); break;
-			case 5: gl_Position = vec4(+1,+1, 0,1); break;
-		}
-	}
-)_SHAD",
-// Fragment shader
-GLSL_VERSION R"_SHAD(
-	out		vec4	frag_col;
-	
-	uniform vec2	wnd_dim;
-	
-	uniform sampler2D 	tex;
-	
-	void main() {
-		frag_col = texture(tex, gl_FragCoord.xy / wnd_dim);
-	}
-)_SHAD"
-	) {}
-	
-	// uniforms
-	Unif_fv2	wnd_dim;
-	
-	void init () {
-		compile();
+		scroll_offset.loc =	glGetUniformLocation(prog, "scroll_offset");
+		dbg_assert(scroll_offset.loc >= 0);
 		
-		wnd_dim.loc =			glGetUniformLocation(prog, "wnd_dim");
-		dbg_assert(wnd_dim.loc >= 0);
+		sdf_aa.loc =		glGetUniformLocation(prog, "sdf_aa");
+		dbg_assert(sdf_aa.loc >= 0);
+		
+		highlighted.loc =	glGetUniformLocation(prog, "highlighted");
+		dbg_assert(highlighted.loc >= 0);
 		
-		auto tex =		glGetUniformLocation(prog, "tex");
+		col_highlighted.loc =	glGetUniformLocation(prog, "col_highlighted");
+		dbg_assert(col_highlighted.loc >= 0);
+		
+		auto tex = 			glGetUniformLocation(prog, "tex");
 		dbg_assert(tex >= 0);
 		glUniform1i(tex, 0);
+		gl_state.count();
 	}
-	void bind_fb (RGBA_Framebuffer cr fb) {
-		glActiveTexture(GL_TEXTURE0 +0);
-		glBindTexture(GL_TEXTURE_2D, fb.tex);
+	void bind_texture (Texture tex) {
+		gl_state.bind_texture(0, tex.gl);
 	}
-	
 };
 
 struct VBO_Cursor_Pass {
 	GLuint	vbo;
+	GLuint	vao; // attribute setup happens once in init(), binding the vao restores it
 	struct V {
 		v2	pos;
 		v4	col;
@@ -404,32 +542,27 @@ struct VBO_Cursor_Pass {
 	
 	void init () {
 		glGenBuffers(1, &vbo);
-	}
-	void upload (std::vector<V> data) {
-		uptr data_size = data.size() * sizeof(V);
+		glGenVertexArrays(1, &vao);
 		
-		glBindBuffer(GL_ARRAY_BUFFER, vbo);
-		glBufferData(GL_ARRAY_BUFFER, data_size, NULL, GL_STATIC_DRAW);
-		glBufferData(GL_ARRAY_BUFFER, data_size, data.data(), GL_STATIC_DRAW);
-		
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
-	}
-	void bind (Basic_Shader cr shad) {
+		gl_state.bind_vao(vao);
+		gl_state.bind_array_buffer(vbo);
 		
-		glBindBuffer(GL_ARRAY_BUFFER, vbo);
+		glEnableVertexAttribArray(ATTRIB_POS);
+		glVertexAttribPointer(ATTRIB_POS,	2, GL_FLOAT, GL_FALSE, sizeof(V), (void*)offsetof(V,pos));
 		
-		GLint	pos =	glGetAttribLocation(shad.prog, "attrib_pos");
-		GLint	col =	glGetAttribLocation(shad.prog, "attrib_col");
-		
-		dbg_assert(pos >= 0);
-		dbg_assert(col >= 0);
-		
-		glEnableVertexAttribArray(pos);
-		glVertexAttribPointer(pos,	2, GL_FLOAT, GL_FALSE, sizeof(V), (void*)offsetof(V,pos));
-		
-		glEnableVertexAttribArray(col);
-		glVertexAttribPointer(col,	4, GL_FLOAT, GL_FALSE, sizeof(V), (void*)offsetof(V,col));
+		glEnableVertexAttribArray(ATTRIB_COL);
+		glVertexAttribPointer(ATTRIB_COL,	4, GL_FLOAT, GL_FALSE, sizeof(V), (void*)offsetof(V,col));
+	}
+	void upload (V const* data, u32 count) {
+		uptr data_size = count * sizeof(V);
 		
+		gl_state.bind_array_buffer(vbo);
+		glBufferData(GL_ARRAY_BUFFER, data_size, NULL, GL_STATIC_DRAW);
+		glBufferData(GL_ARRAY_BUFFER, data_size, data, GL_STATIC_DRAW);
+		gl_state.count(2);
+	}
+	void bind () {
+		gl_state.bind_vao(vao);
 	}
 	
 };
@@ -442,9 +575,11 @@ GLSL_VERSION R"_SHAD(
 	out		vec4	color;
 	
 	uniform vec2	wnd_dim;
+	uniform float	scroll_offset; // px
 	
 	void main() {
 		vec2 tmp = attrib_pos;
+		tmp.y -= scroll_offset;
 		tmp.y = wnd_dim.y -tmp.y;
 		vec2 pos_clip = (tmp / wnd_dim) * 2 -1;
 		
@@ -454,15 +589,10 @@ GLSL_VERSION R"_SHAD(
 )_SHAD",
 // Fragment shader
 GLSL_VERSION R"_SHAD(
-	in		vec2	uv;
 	in		vec4	color;
 	out		vec4	frag_col;
 	
-	uniform vec2	wnd_dim;
 	uniform vec3	col_background;
-	uniform vec3	col_highlighted;
-	
-	uniform sampler2D 	fb_text;
 	
 	void main() {
 		vec3 col = col_background;
@@ -470,21 +600,15 @@ GLSL_VERSION R"_SHAD(
 		col *= 1 -color.a;
 		col += color.rgb * color.a;
 		
-		vec4 text_col = texture(fb_text, gl_FragCoord.xy / wnd_dim);
-		text_col.a = pow(text_col.a, 1.0/3);
-		
-		col *= 1 -text_col.a;
-		col += col_highlighted*text_col.a;
-		
-		frag_col = vec4(col, 1);
+		frag_col = vec4(col, 1); // opaque, so later boxes replace earlier ones, the text on top gets drawn afterwards
 	}
 )_SHAD"
 	) {}
 	
 	// uniforms
 	Unif_fv2	wnd_dim;
+	Unif_flt	scroll_offset;
 	Unif_fv3	col_background;
-	Unif_fv3	col_highlighted;
 	
 	void init () {
 		compile();
@@ -492,19 +616,11 @@ GLSL_VERSION R"_SHAD(
 		wnd_dim.loc =			glGetUniformLocation(prog, "wnd_dim");
 		dbg_assert(wnd_dim.loc >= 0);
 		
+		scroll_offset.loc =		glGetUniformLocation(prog, "scroll_offset");
+		dbg_assert(scroll_offset.loc >= 0);
+		
 		col_background.loc =	glGetUniformLocation(prog, "col_background");
 		dbg_assert(col_background.loc >= 0);
-		
-		col_highlighted.loc =	glGetUniformLocation(prog, "col_highlighted");
-		dbg_assert(col_highlighted.loc >= 0);
-		
-		auto fb_text =		glGetUniformLocation(prog, "fb_text");
-		dbg_assert(fb_text >= 0);
-		glUniform1i(fb_text, 0);
-	}
-	void bind_fb (RGBA_Framebuffer cr fb) {
-		glActiveTexture(GL_TEXTURE0 +0);
-		glBindTexture(GL_TEXTURE_2D, fb.tex);
 	}
 	
 };
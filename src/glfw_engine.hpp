@@ -19,21 +19,51 @@ static bool			fullscreen;
 static Rect			_suggested_wnd_rect;
 static Rect			_restore_wnd_rect;
 
+// glfw callbacks only queue input events, they get applied all at once before drawing
+//  so key repeat storms, fast mouse wheel scrolling or typing bursts result in one frame (per display refresh with vsync) instead of one frame per event
+enum input_event_e : u32 {
+	IE_RESIZE		=0,
+	IE_SCROLL		,
+	IE_TEXT			,
+	IE_KEY			,
+};
+struct Input_Event {
+	input_event_e	type;
+	union {
+		struct { s32 w, h; }						resize;
+		struct { f64 x, y; bool ctrl; }				scroll;
+		ui											codepoint;
+		struct { s32 key, scancode, action, mods; }	key;
+	};
+};
+
+static std::vector<Input_Event>	input_events;
+
 static void glfw_resize (GLFWwindow* window, int width, int height) {
-	resize_wnd( max(iv2(width,height), iv2(1)) );
 	//printf(">>>> %d, %d\n", width, height);
-	draw("glfw_resize()");
+	Input_Event e;
+	e.type = IE_RESIZE;
+	e.resize = { width, height };
+	input_events.push_back(e);
 }
 
 static void glfw_scroll_proc (GLFWwindow* window, f64 xoffset, f64 yoffset) {
-	mouse_scroll( (s32)floor(yoffset) );
-	draw("glfw_scroll_proc()");
+	Input_Event e;
+	e.type = IE_SCROLL;
+	e.scroll = { xoffset, yoffset,
+		glfwGetKey(window, GLFW_KEY_LEFT_CONTROL) == GLFW_PRESS || glfwGetKey(window, GLFW_KEY_RIGHT_CONTROL) == GLFW_PRESS };
+	input_events.push_back(e);
 }
 
 static bool	_resizing_tab_spaces; // needed state for CTRL+T+(+/-) control
 
 static char _filename_buf[512];
 
+static void set_vsync (bool state) {
+	opt.vsync = state;
+	++vsync_gen; // glfwSwapInterval() gets called by the render thread, since that one has the gl context
+}
+
 static void toggle_fullscreen () {
 	if (fullscreen) {
 		glfwSetWindowMonitor(wnd, NULL, _restore_wnd_rect.pos.x,_restore_wnd_rect.pos.y,
@@ -47,7 +77,7 @@ static void toggle_fullscreen () {
 	}
 	fullscreen = !fullscreen;
 	
-	glfwSwapInterval(0); // seems like vsync needs to be set after switching to from the inital hidden window to a fullscreen one, or there will be no vsync
+	set_vsync(opt.vsync); // seems like vsync needs to be set after switching to from the inital hidden window to a fullscreen one, or there will be no vsync
 	
 }
 static void init_show_window (bool fullscreen, Rect rect=_suggested_wnd_rect) {
@@ -73,11 +103,20 @@ static void glfw_error_proc (int err, cstr msg) {
 
 static void glfw_text_proc (GLFWwindow* window, ui codepoint) {
 	//printf("glfw_text_proc: '%c' [%x]\n", codepoint, codepoint);
-	insert_char(codepoint);
-	draw("glfw_text_proc()");
+	Input_Event e;
+	e.type = IE_TEXT;
+	e.codepoint = codepoint;
+	input_events.push_back(e);
 }
 
 static void glfw_key_proc (GLFWwindow* window, int key, int scancode, int action, int mods) {
+	Input_Event e;
+	e.type = IE_KEY;
+	e.key = { key, scancode, action, mods };
+	input_events.push_back(e);
+}
+
+static bool apply_key (int key, int scancode, int action, int mods) { // returns if the key did something
 	dbg_assert(action == GLFW_PRESS || action == GLFW_REPEAT || action == GLFW_RELEASE);
 	
 	//cstr name = glfwGetKeyName(key, scancode);
@@ -139,6 +178,20 @@ static void glfw_key_proc (GLFWwindow* window, int key, int scancode, int action
 			case GLFW_KEY_N:
 				if (action == GLFW_PRESS && (mods & GLFW_MOD_ALT)) {
 					opt.draw_whitespace = !opt.draw_whitespace;
+					invalidate_layout();
+					
+					input_mapped = true;
+				} break;
+			
+			case GLFW_KEY_V:
+				if (action == GLFW_PRESS && (mods & GLFW_MOD_ALT)) {
+					set_vsync(!opt.vsync);
+					printf(">> vsync %s\n", opt.vsync ? "on":"off");
+					
+					input_mapped = true;
+				} else if (action == GLFW_PRESS && (mods & GLFW_MOD_CONTROL)) { // not on repeat, holding it would paste the clipboard many times a second
+					cstr str = glfwGetClipboardString(wnd);
+					if (str) paste((utf8 const*)str, strlen(str));
 					
 					input_mapped = true;
 				} break;
@@ -167,17 +220,104 @@ static void glfw_key_proc (GLFWwindow* window, int key, int scancode, int action
 					input_mapped = true;
 				} break;
 			
+			case GLFW_KEY_J:
+				if (action == GLFW_PRESS && (mods & GLFW_MOD_ALT)) {
+					g_jobs.print_stats();
+					g_jobs.reset_stats();
+					
+					input_mapped = true;
+				} break;
+			
+			case GLFW_KEY_R:
+				if (action == GLFW_PRESS && (mods & GLFW_MOD_ALT)) {
+					opt.print_render_stats = !opt.print_render_stats;
+					
+					input_mapped = true;
+				} break;
+			
+			case GLFW_KEY_F:
+				if (action == GLFW_PRESS && (mods & GLFW_MOD_ALT)) {
+					g_buf.toggle_follow();
+					
+					input_mapped = true;
+				} break;
+			
+			case GLFW_KEY_X:
+				if (action == GLFW_PRESS && (mods & GLFW_MOD_ALT)) {
+					g_buf.toggle_hex_view();
+					
+					input_mapped = true;
+				} break;
+			
+			case GLFW_KEY_Z:
+				if (action == GLFW_PRESS && (mods & GLFW_MOD_ALT)) {
+					g_buf.toggle_fold();
+					
+					input_mapped = true;
+				} break;
+			
+			case GLFW_KEY_B:
+				if (action == GLFW_PRESS && (mods & GLFW_MOD_ALT)) {
+					g_buf.jump_to_matching_bracket();
+					
+					input_mapped = true;
+				} break;
+			
+			case GLFW_KEY_F3:
+				if (action != GLFW_RELEASE) {
+					g_buf.find_next();
+					
+					input_mapped = true;
+				} break;
+			
 		}
 	}
 	
 	if (_resizing_tab_spaces) {
 		opt.tab_spaces = max(opt.tab_spaces +generic_incdec, 1);
+		invalidate_layout();
+	}
+	
+	return input_mapped;
+}
+
+static bool apply_input_events () { // apply all queued input events in order, returns if we need to draw a new frame
+	bool redraw = false;
+	
+	for (auto& e : input_events) {
+		switch (e.type) {
+			case IE_RESIZE: {
+				resize_wnd( max(iv2(e.resize.w,e.resize.h), iv2(1)) );
+				redraw = true;
+			} break;
+			case IE_SCROLL: {
+				if (e.scroll.ctrl) {
+					zoom_font( (s32)floor(e.scroll.y) );
+				} else {
+					mouse_scroll( (s32)floor(e.scroll.y) );
+					mouse_scroll_x( (s32)floor(e.scroll.x) );
+				}
+				redraw = true;
+			} break;
+			case IE_TEXT: {
+				insert_char(e.codepoint);
+				redraw = true;
+			} break;
+			case IE_KEY: {
+				if (apply_key(e.key.key, e.key.scancode, e.key.action, e.key.mods)) redraw = true;
+			} break;
+		}
 	}
 	
-	if (input_mapped) draw("glfw_key_proc()");
+	frame_input_events += (u32)input_events.size();
+	input_events.clear();
+	
+	return redraw;
 }
 
 static void glfw_refresh (GLFWwindow* wnd) {
+	// while the window is being resized or moved the main loop is blocked by the os (at least on windows), so apply the input here
+	apply_input_events();
 	draw("glfw_refresh()");
 }
 
@@ -214,32 +354,50 @@ static void setup_glfw () {
 
 int main (int argc, char** argv) {
 	
+	if (argc == 3 && strcmp(argv[1], "--bench-load") == 0) return bench_load(argv[2]);
+	if (argc == 3 && strcmp(argv[1], "--bench-edit") == 0) return bench_edit(argv[2]);
+	if (argc == 2 && strcmp(argv[1], "--test") == 0) return run_tests();
+	if (argc == 2) g_open_filename = argv[1];
+	
 	setup_glfw();
 	
 	glEnable(GL_FRAMEBUFFER_SRGB);
 	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 	
 	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
 	
-	{ // for ogl 3.3 and up (i'm not using vaos)
-		GLuint vao;
-		glGenVertexArrays(1, &vao);
-		glBindVertexArray(vao);
-	}
+	glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE); // stencil writes the reference value of glStencilFunc where the test passes
+	
+	gl_state.blend_func(GL_ONE, GL_ONE_MINUS_SRC_ALPHA); // all shaders output premultiplied alpha
 	
 	init();
 	
 	do {
-		if (!continuous_drawing) {
-			glfwWaitEvents();
-		} else {
-			glfwPollEvents(); // NOTE: continuous_drawing not working when resizing, since PollEvents blocks and only calls glfw_resize when resized by at least one pixel
+		// with continuous_drawing the render thread wakes us up after presenting each frame (glfwPostEmptyEvent)
+		glfwWaitEvents(); // NOTE: continuous_drawing not working when resizing, since the os blocks the main loop and only calls glfw_resize when resized by at least one pixel
+		
+		// all events that arrived while we were waiting or while the last frame was presented (vsync) get applied together and cause only one frame
+		bool redraw = apply_input_events();
+		
+		if (g_buf.follow_update()) redraw = true; // the file watcher and the stdin reader wake us up with an empty event
+		if (g_buf.stream_update()) redraw = true;
+		if (g_buf.search_update()) redraw = true; // the search job wakes us up with an empty event
+		
+		if (continuous_drawing) {
 			draw("continuous_drawing");
+		} else if (redraw) {
+			draw("input_events");
 		}
 		
 	} while (!glfwWindowShouldClose(wnd));
 	
+	stop_render_thread();
+	g_buf.stop_follow();
+	g_buf.stop_stream();
+	g_buf.cancel_search(); // so shutdown does not wait for it
+	g_buf.journal.close();
+	g_jobs.shutdown();
+	
 	glfwDestroyWindow(wnd);
 	glfwTerminate();
 	
@@ -0,0 +1,292 @@
+
+// Opening gzip compressed files (rotated logs), needs zlib, which the windows build does not have yet, define CEDI_GZIP=1 and link zlib to enable it there
+//  the first open inflates the file front to back on a background thread, the buffer fills up while it runs (streaming, like cedi -),
+//  on the way it records a checkpoint every CHECKPOINT_SPAN bytes of output: the position in the compressed data and the 32k of output before it (back references of deflate reach that far)
+//  the checkpoints get saved to a sidecar next to the file, together with the line index of the output (see Line_Index),
+//  reopening it then works like a mapped file: only the spans that the viewed lines are in get inflated, each one starting at its checkpoint (like zran.c of zlib)
+
+#ifndef CEDI_GZIP
+	#define CEDI_GZIP (RZ_PLATF == RZ_PLATF_GENERIC_UNIX) // zlib is part of every linux install
+#endif
+
+#if CEDI_GZIP
+#include <zlib.h>
+
+static const u32 GZIP_WINDOW = 32 * 1024;
+static const u64 DEFLATE_MAX_RATIO = 1032; // deflate can't compress better than this, so it bounds what some compressed bytes can inflate to
+
+static bool is_gzip (byte const* data, u64 size) {
+	return size >= 2 && data[0] == 0x1f && data[1] == 0x8b;
+}
+
+struct Gzip_Checkpoint {
+	u64		in_pos; // first compressed byte after the checkpoint
+	u64		out_pos; // decompressed bytes before the checkpoint
+	u32		bits; // deflate blocks don't end on byte boundaries, this many high bits of the byte before in_pos come after the checkpoint
+	u32		window_len; // less than GZIP_WINDOW only close to the start
+	byte	window[GZIP_WINDOW]; // the output right before out_pos
+};
+
+static const char GZIP_INDEX_MAGIC[8] = { 'c','e','d','i','g','z','i','1' }; // last char is the format version
+
+struct Gzip_Index {
+	static const u64 CHECKPOINT_SPAN = 4 * 1024 * 1024; // of output, the windows cost 32k per checkpoint, so not too small, but big files should still split into enough jobs
+	
+	u64								total_out = 0;
+	std::vector<Gzip_Checkpoint>	checkpoints; // the first one is where the first deflate stream starts
+	
+	// sidecar file, same stamp as the line index sidecar, the hash is over the compressed bytes
+	struct Sidecar_Header {
+		char	magic[8];
+		u64		file_size;
+		u64		file_mtime;
+		u64		content_hash;
+		u64		total_out;
+		u64		checkpoint_count;
+	};
+	
+	bool load_sidecar (cstr path, Sidecar_Header cr expect) {
+		auto f = fopen(path, "rb");
+		if (!f) return false;
+		defer { fclose(f); };
+		
+		Sidecar_Header h;
+		if (fread(&h, sizeof(h), 1, f) != 1) return false;
+		if (	memcmp(h.magic, GZIP_INDEX_MAGIC, sizeof(h.magic)) != 0 ||
+				h.file_size != expect.file_size || h.file_mtime != expect.file_mtime || h.content_hash != expect.content_hash ||
+				h.checkpoint_count == 0 || h.checkpoint_count > h.file_size / (CHECKPOINT_SPAN / DEFLATE_MAX_RATIO) +1) {
+			return false; // stale or from another version
+		}
+		
+		total_out = h.total_out;
+		checkpoints.resize((uptr)h.checkpoint_count);
+		if (fread(checkpoints.data(), sizeof(Gzip_Checkpoint), checkpoints.size(), f) != checkpoints.size()) return false;
+		
+		// a corrupt sidecar must not make inflate_span() read outside of the file or of a window, or make spans overlap,
+		//  or make a span allocate more than its compressed bytes can inflate to (a bogus total_out)
+		auto in_end = [&] (uptr i) { return i +1 < checkpoints.size() ? checkpoints[i +1].in_pos : h.file_size; };
+		
+		bool valid = checkpoints[0].out_pos == 0 && checkpoints.back().out_pos <= total_out;
+		for (uptr i=0; i<checkpoints.size() && valid; ++i) {
+			auto& cp = checkpoints[i];
+			valid = cp.window_len <= GZIP_WINDOW && cp.bits <= 7 && (cp.bits == 0 || cp.in_pos > 0);
+			valid = valid && cp.in_pos <= in_end(i) && in_end(i) <= h.file_size;
+			valid = valid && (i == 0 || cp.out_pos > checkpoints[i -1].out_pos);
+			valid = valid && span_end((u32)i) -cp.out_pos <= (in_end(i) -cp.in_pos +1) * DEFLATE_MAX_RATIO; // wraps around if the next out_pos is smaller, that fails too
+		}
+		return valid;
+	}
+	void save_sidecar (cstr path, Sidecar_Header h) const { // failing to write (read-only dir) only means the next open streams again
+		memcpy(h.magic, GZIP_INDEX_MAGIC, sizeof(h.magic));
+		h.total_out = total_out;
+		h.checkpoint_count = checkpoints.size();
+		
+		auto f = fopen(path, "wb");
+		if (!f) return;
+		defer { fclose(f); };
+		
+		fwrite(&h, sizeof(h), 1, f);
+		fwrite(checkpoints.data(), sizeof(Gzip_Checkpoint), checkpoints.size(), f);
+	}
+	
+	u64 span_end (u32 i) const {
+		return i +1 < (u32)checkpoints.size() ? checkpoints[i +1].out_pos : total_out;
+	}
+	bool inflate_span (byte const* in, u64 in_len, u32 i, byte* out) const { // output between checkpoint i and the next one (or the end) into out
+		auto& cp = checkpoints[i];
+		u64 out_end = span_end(i);
+		if (cp.in_pos > in_len || (cp.bits && cp.in_pos == 0) || out_end > total_out) return false;
+		
+		z_stream strm = {};
+		if (inflateInit2(&strm, -15) != Z_OK) return false; // raw deflate, there is no header at a checkpoint
+		defer { inflateEnd(&strm); };
+		
+		if (cp.bits) inflatePrime(&strm, (int)cp.bits, in[cp.in_pos -1] >> (8 -cp.bits));
+		if (cp.window_len) inflateSetDictionary(&strm, cp.window, cp.window_len);
+		
+		bool raw = true;
+		u64 in_pos = cp.in_pos;
+		u64 out_pos = cp.out_pos;
+		while (out_pos < out_end) {
+			strm.next_in =		(Bytef*)(in +in_pos);
+			strm.avail_in =		(uInt)min(in_len -in_pos, (u64)1 << 30);
+			strm.next_out =		(Bytef*)(out +(out_pos -cp.out_pos));
+			strm.avail_out =	(uInt)min(out_end -out_pos, (u64)1 << 30);
+			uInt avail_in = strm.avail_in;
+			uInt avail_out = strm.avail_out;
+			
+			int ret = inflate(&strm, Z_NO_FLUSH);
+			in_pos += avail_in -strm.avail_in;
+			out_pos += avail_out -strm.avail_out;
+			
+			if (ret == Z_STREAM_END) { // concatenated gzip members, continue with the next one
+				if (raw) in_pos += 8; // crc and size, in gzip mode zlib reads these itself
+				if (in_pos > in_len || inflateReset2(&strm, 31) != Z_OK) return false;
+				raw = false;
+				continue;
+			}
+			if (ret != Z_OK || (avail_in == strm.avail_in && avail_out == strm.avail_out)) return false; // corrupt or truncated
+		}
+		return true;
+	}
+};
+
+// random access to the output of an indexed gzip file, reads inflate the spans they touch (from the checkpoint before them)
+//  the last CACHE_SPANS spans stay inflated, reads come from the pages on screen, or from worker threads that go through the lines in order
+//  reads can come from any thread
+struct Gzip_Text {
+	static const u32 CACHE_SPANS = 16;
+	
+	byte const*		in = nullptr; // the mapped file, owned by the caller
+	u64				in_len = 0;
+	Gzip_Index		index;
+	
+	struct Cached_Span {
+		u32									i;
+		u64									last_use;
+		std::shared_ptr<std::vector<byte>>	data; // readers keep it alive while it gets evicted
+	};
+	std::mutex					m;
+	std::vector<Cached_Span>	cache;
+	u64							use_count = 0;
+	
+	std::shared_ptr<std::vector<byte>> get_span (u32 i) {
+		{
+			std::lock_guard<std::mutex> lck(m);
+			for (auto& s : cache) {
+				if (s.i != i) continue;
+				s.last_use = ++use_count;
+				return s.data;
+			}
+		}
+		
+		// inflate without holding the lock, so other threads can read other spans meanwhile, two threads inflating the same span only waste some time
+		auto data = std::make_shared<std::vector<byte>>((uptr)(index.span_end(i) -index.checkpoints[i].out_pos));
+		if (!index.inflate_span(in, in_len, i, data->data())) { // the file changed after the sidecar was checked, or is corrupt in a way the stamp does not catch
+			printf("gzip: span %u could not be inflated\n", i);
+			std::fill(data->begin(), data->end(), (byte)0);
+		}
+		
+		std::lock_guard<std::mutex> lck(m);
+		if (cache.size() < CACHE_SPANS) {
+			cache.push_back(Cached_Span{ i, ++use_count, data });
+		} else {
+			auto lru = std::min_element(cache.begin(), cache.end(), [] (Cached_Span cr l, Cached_Span cr r) { return l.last_use < r.last_use; });
+			*lru = Cached_Span{ i, ++use_count, data };
+		}
+		return data;
+	}
+	
+	void read (u64 b, u64 e, byte* out) { // output bytes [b, e)
+		dbg_assert(b <= e && e <= index.total_out);
+		auto& cps = index.checkpoints;
+		u32 i = (u32)(std::upper_bound(cps.begin(), cps.end(), b, [] (u64 pos, Gzip_Checkpoint cr cp) { return pos < cp.out_pos; }) -cps.begin()) -1;
+		
+		while (b < e) {
+			auto span = get_span(i);
+			u64 first = cps[i].out_pos;
+			u64 n = min(e, first +(u64)span->size()) -b;
+			memcpy(out, span->data() +(b -first), (size_t)n);
+			out += n;
+			b += n;
+			i += 1;
+		}
+	}
+};
+
+// inflates a whole file front to back and builds its index on the way
+struct Gzip_Reader {
+	Mapped_File						file = {};
+	Gzip_Index::Sidecar_Header		stamp;
+	std::string						sidecar_path;
+	
+	z_stream						strm = {};
+	u64								in_pos = 0;
+	u64								out_pos = 0;
+	u64								member_end = (u64)-1; // out_pos where the last gzip member ended, data that is not another member after that is padding
+	bool							done = false;
+	bool							failed = false;
+	
+	std::vector<byte>				history; // the last GZIP_WINDOW bytes of output before the current read() call
+	Gzip_Index						index;
+	
+	bool init (Mapped_File cr f, Gzip_Index::Sidecar_Header cr stamp, std::string cr sidecar_path) { // takes over the mapping
+		file = f;
+		this->stamp = stamp;
+		this->sidecar_path = sidecar_path;
+		return inflateInit2(&strm, 47) == Z_OK; // 32: detect gzip or zlib header
+	}
+	~Gzip_Reader () {
+		inflateEnd(&strm);
+		if (file.data) unmap_file(&file);
+	}
+	
+	void add_checkpoint (byte const* out, uptr produced) { // out: output of the current read() call so far
+		index.checkpoints.emplace_back();
+		auto& cp = index.checkpoints.back();
+		cp.in_pos =		in_pos;
+		cp.out_pos =	out_pos +produced;
+		cp.bits =		(u32)(strm.data_type & 7);
+		
+		uptr from_out = min(produced, (uptr)GZIP_WINDOW);
+		uptr from_hist = min(history.size(), (uptr)GZIP_WINDOW -from_out);
+		if (from_hist) memcpy(cp.window, history.data() +history.size() -from_hist, from_hist);
+		memcpy(cp.window +from_hist, out +produced -from_out, from_out);
+		cp.window_len = (u32)(from_hist +from_out);
+	}
+	
+	sptr read (byte* out, uptr size) { // like read_stdin(), 0 at the end, < 0 if the data is corrupt (what was read until then is still valid)
+		if (done) return failed ? -1 : 0;
+		
+		strm.next_out =		(Bytef*)out;
+		strm.avail_out =	(uInt)min(size, (uptr)1 << 30);
+		uInt out_size = strm.avail_out;
+		
+		while (strm.avail_out) {
+			if (in_pos == file.size) {
+				done = true; // truncated if the last member did not end, show what we got
+				break;
+			}
+			strm.next_in =	(Bytef*)(file.data +in_pos);
+			strm.avail_in =	(uInt)min(file.size -in_pos, (u64)1 << 30);
+			uInt avail_in = strm.avail_in;
+			uInt avail_out = strm.avail_out;
+			
+			int ret = inflate(&strm, Z_BLOCK); // returns at every block boundary, those are the places a checkpoint can be
+			in_pos += avail_in -strm.avail_in;
+			uptr produced = out_size -strm.avail_out;
+			
+			if (ret == Z_BUF_ERROR && avail_in == strm.avail_in && avail_out == strm.avail_out) ret = Z_DATA_ERROR; // no progress
+			
+			if (ret == Z_STREAM_END) {
+				member_end = out_pos +produced;
+				inflateReset(&strm);
+				continue;
+			}
+			if (ret != Z_OK && ret != Z_BUF_ERROR) {
+				done = true;
+				failed = member_end != out_pos +produced; // else it's only padding after the last member
+				break;
+			}
+			
+			bool block_end = (strm.data_type & 128) && !(strm.data_type & 64);
+			if (block_end && (index.checkpoints.size() == 0 || out_pos +produced -index.checkpoints.back().out_pos >= Gzip_Index::CHECKPOINT_SPAN)) {
+				add_checkpoint(out, produced);
+			}
+		}
+		uptr produced = out_size -strm.avail_out;
+		
+		// keep the last GZIP_WINDOW bytes of output for the checkpoints in the next call
+		history.insert(history.end(), out +produced -min(produced, (uptr)GZIP_WINDOW), out +produced);
+		if (history.size() > GZIP_WINDOW) history.erase(history.begin(), history.end() -GZIP_WINDOW);
+		out_pos += produced;
+		
+		if (done && !failed && index.checkpoints.size()) {
+			index.total_out = out_pos;
+			index.save_sidecar(sidecar_path.c_str(), stamp);
+		}
+		if (produced) return (sptr)produced; // an error gets reported with the next call
+		return failed ? -1 : 0;
+	}
+};
+#endif
@@ -64,6 +64,8 @@
 	#elif RZ_PLATF == RZ_PLATF_GENERIC_UNIX
 		#if RZ_ARCH == RZ_ARCH_ARM_V6_HF
 			#define DBGBREAK				do { asm volatile ("bkpt #0"); } while(0)
+		#elif RZ_ARCH == RZ_ARCH_X64
+			#define DBGBREAK				do { asm volatile ("int3"); } while(0)
 		#endif
 	#endif
 	
@@ -103,6 +105,36 @@
 		
 	#endif
 	
+#elif RZ_PLATF == RZ_PLATF_GENERIC_UNIX
+	
+	#if RZ_DBG
+		
+		#include <cstdio>
+		#include <unistd.h>
+		
+		static bool _is_debugger_present () { // a debugger attached with ptrace shows up as the TracerPid in /proc/self/status
+			FILE* f = fopen("/proc/self/status", "r");
+			if (!f) return false;
+			
+			char line[256];
+			int tracer = 0;
+			while (fgets(line, sizeof(line), f)) {
+				if (sscanf(line, "TracerPid: %d", &tracer) == 1) break;
+			}
+			fclose(f);
+			return tracer != 0;
+		}
+		
+		#define IS_DEBUGGER_PRESENT				_is_debugger_present()
+		#define DBGBREAK_IF_DEBUGGER_PRESENT	if (IS_DEBUGGER_PRESENT) { DBGBREAK; }
+		#define BREAK_IF_DEBUGGING_ELSE_STALL	if (IS_DEBUGGER_PRESENT) { DBGBREAK; } else { usleep(100 * 1000); }
+		
+		static void dbg_sleep (f32 sec) {
+			usleep( (useconds_t)(sec * 1000000.0f) );
+		}
+		
+	#endif
+	
 #endif
 
 ////
@@ -391,7 +423,10 @@ static T* lsearch (std::vector<T>& arr, FUNC comp_with) {
 
 static void _prints (std::string* s, cstr format, va_list vl) { // print 
 	for (;;) {
-		auto ret = vsnprintf(&(*s)[0], s->length()+1, format, vl); // i think i'm technically not allowed to overwrite the null terminator
+		va_list vl_copy; // vl can only be consumed once (on x64 unix it's a pointer to state that vsnprintf advances)
+		va_copy(vl_copy, vl);
+		auto ret = vsnprintf(&(*s)[0], s->length()+1, format, vl_copy); // i think i'm technically not allowed to overwrite the null terminator
+		va_end(vl_copy);
 		dbg_assert(ret >= 0);
 		bool was_big_enough = (u32)ret < s->length()+1;
 		s->resize((u32)ret);
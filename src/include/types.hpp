@@ -13,7 +13,11 @@ typedef unsigned long long	ullong;
 static_assert(sizeof(schar) ==	1, "sizeof(schar) !=	1");
 static_assert(sizeof(sshort) ==	2, "sizeof(sshort) !=	2");
 static_assert(sizeof(si) ==		4, "sizeof(si) !=		4");
-static_assert(sizeof(slong) ==	4, "sizeof(slong) !=	4");
+#if RZ_PLATF == RZ_PLATF_GENERIC_WIN
+static_assert(sizeof(slong) ==	4, "sizeof(slong) !=	4"); // LLP64
+#else
+static_assert(sizeof(slong) ==	sizeof(void*), "sizeof(slong) !=	sizeof(void*)"); // LP64 (or ILP32 on 32 bit arm)
+#endif
 static_assert(sizeof(sllong) ==	8, "sizeof(sllong) !=	8");
 
 typedef schar				s8;
@@ -0,0 +1,233 @@
+
+// Work-stealing thread pool for background work (file loading, search, syntax highlighting, layout)
+//  every worker has its own deque per priority, it pushes and pops its own jobs at the back (newest first, the data is still in cache),
+//  workers that ran dry steal from the front of the other deques (oldest first, those are usually the biggest pieces of work)
+//  jobs from threads that are not workers (main thread) go into a shared injection deque that all workers take from
+//  deques are guarded by one mutex each, there is only contention when workers steal, which only happens when they are out of work
+
+enum Job_Priority : u32 {
+	JOB_PRIO_HIGH =		0, // the ui waits for it (layout)
+	JOB_PRIO_LOW,			// background work (search, syntax highlighting)
+	JOB_PRIO_COUNT,
+};
+
+// jobs that belong to one piece of work, to wait for all of them, or to cancel the ones that did not start yet
+//  long running jobs should poll is_cancelled() themselves
+struct Job_Group {
+	std::atomic<u32>	pending {0};
+	std::atomic<bool>	cancelled {false};
+	
+	void cancel () {				cancelled.store(true, std::memory_order_relaxed); }
+	bool is_cancelled () const {	return cancelled.load(std::memory_order_relaxed); }
+	bool done () const {			return pending.load(std::memory_order_acquire) == 0; }
+};
+
+struct Job {
+	std::function<void()>	func;
+	Job_Group*				group;
+};
+
+static thread_local u32 job_worker_indx = (u32)-1; // which worker the current thread is, -1 for threads that are not workers
+static thread_local u32 job_nesting = 0; // jobs run from wait() inside of a job are already part of the busy time of the outer job
+
+struct Job_System {
+	struct Job_Queue {
+		std::mutex			m;
+		std::deque<Job>		jobs[JOB_PRIO_COUNT];
+		
+		// stats, written by the worker that owns this queue, the ones of the injection queue by every non-worker that runs jobs in wait(), so they are atomic
+		std::atomic<u64>	busy_ns {0};
+		std::atomic<u64>	jobs_run {0};
+		std::atomic<u64>	jobs_stolen {0};
+	};
+	
+	u32							worker_count = 0;
+	std::unique_ptr<Job_Queue[]>	queues; // [0, worker_count) workers, [worker_count] injection queue (and stats of jobs that non-workers ran while waiting)
+	std::vector<std::thread>	threads;
+	
+	std::atomic<u32>			queued {0}; // jobs in all queues, workers sleep while this is 0
+	std::mutex					sleep_m;
+	std::condition_variable		sleep_cv;
+	bool						quit = false;
+	
+	std::chrono::steady_clock::time_point	stats_start;
+	
+	static u64 now_ns () {
+		return (u64)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+	
+	static u32 default_worker_count () { // one worker per core, except for the core the main thread runs on
+		return max(std::thread::hardware_concurrency(), 2u) -1;
+	}
+	
+	void init (u32 count=default_worker_count()) { // 0 workers is valid, then wait() runs all jobs on the waiting thread
+		worker_count = count;
+		quit = false;
+		queues = std::unique_ptr<Job_Queue[]>(new Job_Queue[count +1]);
+		stats_start = std::chrono::steady_clock::now();
+		
+		for (u32 i=0; i<count; ++i) {
+			threads.emplace_back([this, i] () { worker_proc(i); });
+		}
+	}
+	void shutdown () { // jobs that did not start yet are dropped, init() can be called again afterwards
+		{
+			std::lock_guard<std::mutex> lck(sleep_m);
+			quit = true;
+		}
+		sleep_cv.notify_all();
+		
+		for (auto& t : threads) t.join();
+		threads.clear();
+		
+		// the groups of the dropped jobs can be gone already, a later init() must not see them
+		queues.reset();
+		queued = 0;
+		worker_count = 0;
+	}
+	
+	//
+	void submit (Job_Group* group, Job_Priority prio, std::function<void()> func) {
+		if (group) group->pending.fetch_add(1, std::memory_order_relaxed);
+		
+		u32 q = job_worker_indx < worker_count ? job_worker_indx : worker_count;
+		{
+			std::lock_guard<std::mutex> lck(queues[q].m);
+			queues[q].jobs[prio].push_back({ std::move(func), group });
+		}
+		queued.fetch_add(1, std::memory_order_release);
+		
+		{ // lock so that a worker that just saw queued == 0 can't miss the notify
+			std::lock_guard<std::mutex> lck(sleep_m);
+		}
+		sleep_cv.notify_one();
+	}
+	
+	void wait (Job_Group* group) { // runs jobs of the group while waiting, so waiting from inside a job can't deadlock
+		while (!group->done()) {
+			// only jobs of this group, a long low priority job of some other work would delay the waiter (the main thread waiting for layout)
+			if (!try_run_one(group)) std::this_thread::yield(); // the remaining jobs of the group are already running on other workers
+		}
+	}
+	
+	// calls func(b, e) for sub ranges [b, e) of [begin, end) of at most grain elements, on all workers, returns when all are done
+	template <typename INDX_T, typename FUNC>
+	void parallel_for (INDX_T begin, INDX_T end, INDX_T grain, FUNC func, Job_Priority prio=JOB_PRIO_HIGH, Job_Group* cancel=nullptr) {
+		Job_Group group;
+		for (INDX_T b=begin; b<end; b+=grain) {
+			INDX_T e = min(b +grain, end);
+			submit(&group, prio, [=] () {
+				if (cancel && cancel->is_cancelled()) return;
+				func(b, e);
+			});
+		}
+		wait(&group);
+	}
+	
+	//
+	static bool take_job (std::deque<Job>& jobs, bool newest, Job_Group* only, Job* job) { // only != null: the first job of that group
+		if (!only) {
+			if (jobs.empty()) return false;
+			if (newest) {
+				*job = std::move(jobs.back());
+				jobs.pop_back();
+			} else {
+				*job = std::move(jobs.front());
+				jobs.pop_front();
+			}
+			return true;
+		}
+		
+		// the jobs of one group were usually submitted together, so this does not scan far
+		for (uptr i=0; i<jobs.size(); ++i) {
+			uptr j = newest ? jobs.size() -1 -i : i;
+			if (jobs[j].group != only) continue;
+			
+			*job = std::move(jobs[j]);
+			jobs.erase(jobs.begin() +(sptr)j);
+			return true;
+		}
+		return false;
+	}
+	bool pop_job (u32 self, Job* job, bool* stolen, Job_Group* only=nullptr) {
+		for (u32 prio=0; prio<JOB_PRIO_COUNT; ++prio) {
+			{ // own queue, workers take the newest job, non-workers the oldest one of the injection queue
+				auto& q = queues[self];
+				std::lock_guard<std::mutex> lck(q.m);
+				if (take_job(q.jobs[prio], self < worker_count, only, job)) {
+					*stolen = false;
+					return true;
+				}
+			}
+			for (u32 i=1; i<=worker_count; ++i) { // injection queue and other workers, oldest first
+				u32 other = (self +i) % (worker_count +1);
+				
+				auto& q = queues[other];
+				std::lock_guard<std::mutex> lck(q.m);
+				if (take_job(q.jobs[prio], false, only, job)) {
+					*stolen = other != worker_count;
+					return true;
+				}
+			}
+		}
+		return false;
+	}
+	bool try_run_one (Job_Group* only=nullptr) { // only != null: only run a job of that group
+		u32 self = job_worker_indx < worker_count ? job_worker_indx : worker_count;
+		
+		Job job;
+		bool stolen;
+		if (!pop_job(self, &job, &stolen, only)) return false;
+		queued.fetch_sub(1, std::memory_order_relaxed);
+		
+		u64 t0 = job_nesting == 0 ? now_ns() : 0;
+		
+		job_nesting++;
+		if (!job.group || !job.group->is_cancelled()) job.func();
+		job_nesting--;
+		
+		auto& stats = queues[self];
+		if (job_nesting == 0) stats.busy_ns.fetch_add(now_ns() -t0, std::memory_order_relaxed);
+		stats.jobs_run.fetch_add(1, std::memory_order_relaxed);
+		if (stolen) stats.jobs_stolen.fetch_add(1, std::memory_order_relaxed);
+		
+		if (job.group) job.group->pending.fetch_sub(1, std::memory_order_release);
+		return true;
+	}
+	
+	void worker_proc (u32 indx) {
+		job_worker_indx = indx;
+		
+		for (;;) {
+			if (try_run_one()) continue;
+			
+			std::unique_lock<std::mutex> lck(sleep_m);
+			sleep_cv.wait(lck, [this] () { return quit || queued.load(std::memory_order_acquire) > 0; });
+			if (quit) break;
+		}
+	}
+	
+	// utilization = time spent running jobs / time since the stats were reset
+	void reset_stats () {
+		for (u32 i=0; i<=worker_count; ++i) {
+			queues[i].busy_ns = 0;
+			queues[i].jobs_run = 0;
+			queues[i].jobs_stolen = 0;
+		}
+		stats_start = std::chrono::steady_clock::now();
+	}
+	void print_stats () {
+		f64 wall_ns = (f64)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() -stats_start).count();
+		
+		printf("jobs: %u workers, %.1f s since stats reset\n", worker_count, wall_ns * 1e-9);
+		for (u32 i=0; i<=worker_count; ++i) {
+			auto& q = queues[i];
+			printf("  %-8s %3u: %5.1f%% busy  %8llu jobs  %8llu stolen\n",
+					i < worker_count ? "worker" : "external", i,
+					(f64)q.busy_ns.load() / wall_ns * 100,
+					(unsigned long long)q.jobs_run.load(), (unsigned long long)q.jobs_stolen.load());
+		}
+	}
+};
+
+static Job_System g_jobs;
@@ -0,0 +1,186 @@
+
+// Append-only journal of edits, so a crash does not lose anything that was typed since the file was opened
+//  the editing thread only appends the record to a memory buffer (a lock and a memcpy), a writer thread writes the buffer
+//  and fsyncs at most every SYNC_INTERVAL_MS, so a burst of typing costs one fsync instead of one per keystroke
+//  on open the journal gets replayed over the original file, it is only valid for the exact file contents it was started on (same stamp)
+
+enum Journal_Op : u32 {
+	JOP_INSERT_CHAR =		1, // data = the utf32 char
+	JOP_INSERT_ENTER,
+	JOP_DELETE_PREV,
+	JOP_DELETE_NEXT,
+	JOP_INSERT_TEXT, // data = the utf8 text (paste)
+	JOP_DELETE_RANGE, // data = s64 line and char of the end of the range, the record position is the start
+};
+
+struct Journal_Header {
+	char	magic[8];
+	u64		file_size; // stamp of the file the edits apply to
+	u64		file_mtime;
+	u64		content_hash;
+};
+static const char JOURNAL_MAGIC[8] = { 'c','e','d','i','j','r','n','2' }; // last char is the format version
+
+struct Journal_Record { // followed by len bytes of data
+	u32		check; // hash of the rest of the record and the data, a record that was only partially written before a crash ends the journal
+	u32		op;
+	s64		l; // cursor position the edit happened at
+	s64		c;
+	u32		len;
+	u32		_pad;
+	
+	u32 calc_check (void const* data) const {
+		u64 h = hash_fnv1a(&op, sizeof(Journal_Record) -sizeof(check));
+		return (u32)hash_fnv1a(data, len, h);
+	}
+};
+
+struct Journal {
+	static const u32	SYNC_INTERVAL_MS =	50;
+	static const uptr	SYNC_BYTES =		256 * 1024; // sync early if this much piled up
+	
+	FILE*					f = nullptr;
+	
+	std::mutex				m;
+	std::condition_variable	cv;
+	std::vector<byte>		pending; // appended to by the editing thread
+	bool					quit = false;
+	
+	std::thread				thread;
+	std::vector<byte>		writing; // only touched by the writer thread
+	
+	// stats
+	u64						records = 0;
+	u64						record_ns = 0; // time the editing thread spent in record()
+	std::atomic<u64>		syncs {0};
+	
+	bool is_open () const {		return f != nullptr; }
+	
+	// replays all valid records by calling apply(Journal_Record cr, byte const* data), returns false if there is no journal for this exact file
+	//  data is not aligned, copy values out of it
+	//  valid_size gets the size of the journal up to the last complete record, anything after that is garbage from a crash
+	template <typename APPLY>
+	static bool replay (cstr path, Journal_Header cr stamp, u64* valid_size, APPLY apply) {
+		std::vector<byte> data;
+		if (!load_file(path, &data) || data.size() < sizeof(Journal_Header)) return false;
+		
+		Journal_Header h;
+		memcpy(&h, data.data(), sizeof(h));
+		if (	memcmp(h.magic, JOURNAL_MAGIC, sizeof(h.magic)) != 0 ||
+				h.file_size != stamp.file_size || h.file_mtime != stamp.file_mtime || h.content_hash != stamp.content_hash) {
+			return false;
+		}
+		
+		uptr pos = sizeof(Journal_Header);
+		while (data.size() -pos >= sizeof(Journal_Record)) {
+			Journal_Record r;
+			memcpy(&r, data.data() +pos, sizeof(r));
+			
+			uptr size = sizeof(Journal_Record) +(uptr)r.len;
+			if (size > data.size() -pos) break;
+			
+			byte const* rec_data = data.data() +pos +sizeof(Journal_Record);
+			if (r.check != r.calc_check(rec_data)) break;
+			
+			apply(r, rec_data);
+			pos += size;
+		}
+		
+		*valid_size = pos;
+		return true;
+	}
+	
+	// continue_size: size from replay() to append to an existing journal, 0 to start a new one
+	bool open (cstr path, Journal_Header stamp, u64 continue_size) {
+		close();
+		
+		if (continue_size) {
+			f = fopen(path, "r+b");
+			if (f && (!truncate_file(f, continue_size) || fseek(f, 0, SEEK_END) != 0)) {
+				fclose(f);
+				f = nullptr;
+			}
+		}
+		if (!f) {
+			f = fopen(path, "wb");
+			if (!f) return false;
+			
+			memcpy(stamp.magic, JOURNAL_MAGIC, sizeof(stamp.magic));
+			fwrite(&stamp, sizeof(stamp), 1, f);
+			sync_file(f);
+		}
+		
+		quit = false;
+		records = 0;
+		record_ns = 0;
+		syncs = 0;
+		thread = std::thread([this] () { writer_proc(); });
+		return true;
+	}
+	void close () { // writes everything that is still pending
+		if (!f) return;
+		
+		{
+			std::lock_guard<std::mutex> lck(m);
+			quit = true;
+		}
+		cv.notify_one();
+		thread.join();
+		
+		fclose(f);
+		f = nullptr;
+		
+		if (records)
+			printf("journal: %llu records, %llu fsyncs, %.2f us per record\n",
+				(unsigned long long)records, (unsigned long long)syncs.load(), (f64)record_ns / (f64)records * 1e-3);
+	}
+	
+	void record (Journal_Op op, s64 l, s64 c, void const* data=nullptr, u32 len=0) { // len in bytes
+		if (!f) return;
+		auto t0 = std::chrono::steady_clock::now();
+		
+		Journal_Record r = {};
+		r.op = op;
+		r.l = l;
+		r.c = c;
+		r.len = len;
+		r.check = r.calc_check(data);
+		
+		bool wake;
+		{
+			std::lock_guard<std::mutex> lck(m);
+			wake = pending.size() == 0; // else the writer was already woken and is waiting for the sync interval
+			pending.insert(pending.end(), (byte const*)&r, (byte const*)(&r +1));
+			pending.insert(pending.end(), (byte const*)data, (byte const*)data +len);
+			wake = wake || pending.size() >= SYNC_BYTES;
+		}
+		if (wake) cv.notify_one();
+		
+		++records;
+		record_ns += (u64)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() -t0).count();
+	}
+	
+	void writer_proc () {
+		std::unique_lock<std::mutex> lck(m);
+		for (;;) {
+			cv.wait(lck, [this] () { return quit || pending.size(); });
+			
+			// let more records pile up, unless we are shutting down
+			cv.wait_for(lck, std::chrono::milliseconds((s64)SYNC_INTERVAL_MS), [this] () { return quit || pending.size() >= SYNC_BYTES; });
+			
+			std::swap(pending, writing);
+			bool done = quit;
+			lck.unlock();
+			
+			if (writing.size()) {
+				fwrite(writing.data(), 1, writing.size(), f);
+				sync_file(f);
+				syncs.fetch_add(1, std::memory_order_relaxed);
+				writing.clear();
+			}
+			
+			lck.lock();
+			if (done && pending.size() == 0) break;
+		}
+	}
+};
@@ -0,0 +1,240 @@
+
+// newline rules of utf8 text: "\n", "\r", "\r\n" and "\n\r" each end a line
+
+static u64 next_line_start (utf8 const* str, u64 len, u64 pos) { // first line start at or after pos (one that a sequential decode would also start a line at), len if none
+	while (pos < len) {
+		auto* nl = (utf8 const*)memchr(str +pos, '\n', (size_t)(len -pos));
+		if (!nl) return len;
+		pos = (u64)(nl -str) +1;
+		
+		// a '\n' always ends a line, unless it is followed by a '\r', then the line could be "\n\r" or the '\r' starts the next line, so look further
+		if (pos == len || str[pos] != '\r') return pos;
+	}
+	return len;
+}
+static u64 skip_line_end (utf8 const* str, u64 len, u64 i) { // str[i] is '\n' or '\r', returns the index after the newline (pair)
+	utf8 c = str[i++];
+	if (i < len && (str[i] == '\n' || str[i] == '\r') && str[i] != c) ++i;
+	return i;
+}
+static buf_indx_t count_line_ends (utf8 const* str, u64 len) { // chunks from split_line_chunks() never split a newline pair
+	buf_indx_t count = 0;
+	for (u64 i=0; i<len;) {
+		utf8 c = str[i];
+		if (c != '\n' && c != '\r') {
+			++i;
+			continue;
+		}
+		i = skip_line_end(str, len, i);
+		++count;
+	}
+	return count;
+}
+static u64 skip_lines (utf8 const* str, u64 len, u64 pos, buf_indx_t n) { // start of the n-th line after the one starting at pos, len if the text ends before
+	for (; n > 0 && pos < len; ++pos) {
+		utf8 c = str[pos];
+		if (c != '\n' && c != '\r') continue;
+		
+		pos = skip_line_end(str, len, pos) -1;
+		--n;
+	}
+	return pos;
+}
+
+template <typename EMIT>
+static void decode_utf8_lines (utf8 const* str, u64 len, buf_indx_t l, EMIT emit) { // calls emit(buf_indx_t l, utf32 c) for every char, l starts at the passed l and increments after every newline, the chars are exactly the ones of str, so the result does not depend on l
+	auto* in = str;
+	auto* end = str +len;
+	
+	while (in != end) {
+		utf32 c = utf8_to_utf32(&in, end);
+		emit(l, c);
+		
+		if (c == U'\n' || c == U'\r') {
+			if (in != end && (*in == '\n' || *in == '\r') && (utf32)*in != c) {
+				emit(l, utf8_to_utf32(&in, end));
+			}
+			++l;
+		}
+	}
+}
+
+static void split_line_chunks (utf8 const* str, u64 len, u64 chunk_size, std::vector<u64>* bounds) { // chunk i is [bounds[i], bounds[i+1]), always at least one chunk
+	bounds->clear();
+	u64 pos = 0;
+	do {
+		bounds->push_back(pos);
+		pos = next_line_start(str, len, min(pos +chunk_size, len));
+	} while (pos < len);
+	bounds->push_back(len);
+}
+
+static const char LINE_INDEX_MAGIC[8] = { 'c','e','d','i','i','d','x','2' }; // last char is the format version
+
+// Sparse index of line starts, the start of every CHECKPOINT_LINES-th line, so finding any line only scans a few lines from the closest checkpoint
+//  building it is one parallel pass over the bytes (no decoding), and it gets saved to a sidecar file next to the text file,
+//  so reopening a huge file (logs) only needs to map it and read the sidecar
+//  it gets extended with only the new bytes of a text that grows (follow mode, a gzip file being inflated), those don't need to be in one piece with the rest
+struct Line_Index {
+	typedef buf_indx_t indx_t;
+	
+	static const u32 CHECKPOINT_LINES = 64;
+	static const u64 SCAN_CHUNK_MIN = 4 * 1024 * 1024;
+	
+	indx_t				line_count = 0;
+	std::vector<u64>	checkpoints; // start of line i * CHECKPOINT_LINES
+	
+	u64					text_len = 0; // bytes that are indexed
+	u64					last_start = 0; // start of the last line
+	utf8				open_newline = 0; // != 0: the text ends with this newline char on its own, a complementary one after it makes a pair with it
+	
+	void reset () {
+		line_count = 1;
+		checkpoints.assign(1, 0);
+		text_len = 0;
+		last_start = 0;
+		open_newline = 0;
+	}
+	void build (utf8 const* str, u64 len) {
+		reset();
+		extend(str, len);
+	}
+	void extend (utf8 const* str, u64 len) { // the len bytes of str got appended to the text, str does not need to hold anything before them
+		if (len == 0) return;
+		u64 base = text_len; // offset of str in the text
+		text_len += len;
+		
+		// a newline pair split by the old end, the second char belongs to the line before, the last line starts after it
+		if (open_newline && (str[0] == '\n' || str[0] == '\r') && str[0] != open_newline) {
+			str += 1;
+			len -= 1;
+			base += 1;
+			last_start = base;
+			if ((line_count -1) % CHECKPOINT_LINES == 0) checkpoints.back() = base;
+		}
+		open_newline = 0;
+		
+		std::vector<u64> bounds;
+		split_line_chunks(str, len, max(len / ((g_jobs.worker_count +1) * 4) +1, SCAN_CHUNK_MIN), &bounds);
+		u32 chunks = (u32)bounds.size() -1;
+		
+		std::vector<indx_t> first_line(chunks +1);
+		g_jobs.parallel_for<u32>(0, chunks, 1, [&] (u32 b, u32 e) {
+			for (u32 i=b; i<e; ++i)
+				first_line[i +1] = count_line_ends(str +bounds[i], bounds[i +1] -bounds[i]);
+		});
+		first_line[0] = line_count -1; // the first chunk continues the last line
+		for (u32 i=0; i<chunks; ++i) first_line[i +1] += first_line[i];
+		
+		line_count = first_line[chunks] +1; // the line after the last newline, always exists, even if empty
+		checkpoints.resize((uptr)((line_count +CHECKPOINT_LINES -1) / CHECKPOINT_LINES));
+		
+		std::vector<u64> line_start(chunks, 0); // start of the last line that starts in a chunk, 0 if none does
+		
+		g_jobs.parallel_for<u32>(0, chunks, 1, [&] (u32 b, u32 e) {
+			for (u32 i=b; i<e; ++i) {
+				bool last_chunk = i == chunks -1;
+				indx_t l = first_line[i];
+				u64 end = bounds[i +1];
+				
+				// the other chunks start at line starts, the first one continues the last line, which has its checkpoint already
+				if (i > 0 && l % CHECKPOINT_LINES == 0) checkpoints[(uptr)(l / CHECKPOINT_LINES)] = base +bounds[i];
+				
+				for (u64 pos=bounds[i]; pos<end;) {
+					utf8 c = str[pos];
+					if (c != '\n' && c != '\r') {
+						++pos;
+						continue;
+					}
+					u64 nl = pos;
+					pos = skip_line_end(str, len, pos);
+					++l;
+					
+					// the line after the last newline of a chunk is the first line of the next chunk
+					if (l % CHECKPOINT_LINES == 0 && (pos < end || last_chunk)) checkpoints[(uptr)(l / CHECKPOINT_LINES)] = base +pos;
+					
+					line_start[i] = pos;
+					if (last_chunk && pos == len && pos -nl == 1) open_newline = c; // only one thread runs the last chunk
+				}
+			}
+		});
+		
+		for (u32 i=chunks; i-- > 0;) {
+			if (line_start[i] == 0) continue; // no line end in this chunk
+			last_start = base +line_start[i];
+			break;
+		}
+	}
+	
+	void find_line (utf8 const* str, u64 len, indx_t l, u64* begin, u64* end) const { // bytes of line l including its newline
+		dbg_assert(l >= 0 && l < line_count);
+		*begin =	skip_lines(str, len, checkpoints[(uptr)(l / CHECKPOINT_LINES)], l % CHECKPOINT_LINES);
+		*end =		skip_lines(str, len, *begin, 1);
+	}
+	
+	// sidecar file
+	//  size and mtime catch almost every change, the hash of the start and end of the file catches files that were rewritten within the mtime resolution
+	struct Sidecar_Header {
+		char	magic[8];
+		u64		file_size;
+		u64		file_mtime;
+		u64		content_hash;
+		u64		line_count;
+		u64		checkpoint_lines;
+		u64		text_len;
+		u64		last_start;
+		u64		open_newline;
+	};
+	
+	static u64 content_hash (utf8 const* str, u64 len) {
+		u64 n = min(len, (u64)64 * 1024);
+		u64 h = hash_fnv1a(str, (uptr)n);
+		return hash_fnv1a(str +len -n, (uptr)n, h);
+	}
+	
+	bool load_sidecar (cstr path, Sidecar_Header cr expect, u64 len) { // len: of the text the checkpoints have to be offsets into
+		auto f = fopen(path, "rb");
+		if (!f) return false;
+		defer { fclose(f); };
+		
+		Sidecar_Header h;
+		if (fread(&h, sizeof(h), 1, f) != 1) return false;
+		if (	memcmp(h.magic, LINE_INDEX_MAGIC, sizeof(h.magic)) != 0 ||
+				h.file_size != expect.file_size || h.file_mtime != expect.file_mtime || h.content_hash != expect.content_hash ||
+				h.checkpoint_lines != CHECKPOINT_LINES || h.line_count == 0 || h.text_len != len) {
+			return false; // stale or from another version
+		}
+		
+		line_count = (indx_t)h.line_count;
+		checkpoints.resize((uptr)((line_count +CHECKPOINT_LINES -1) / CHECKPOINT_LINES));
+		if (fread(checkpoints.data(), sizeof(u64), checkpoints.size(), f) != checkpoints.size()) return false;
+		
+		text_len = h.text_len;
+		last_start = h.last_start;
+		open_newline = (utf8)h.open_newline;
+		
+		// a corrupt sidecar (or a changed file that still matches the stamp) must not make find_line() read outside of the text
+		//  every group of CHECKPOINT_LINES lines has at least that many newline bytes, so the checkpoints strictly increase
+		bool valid = checkpoints[0] == 0 && checkpoints.back() <= last_start && last_start <= len;
+		valid = valid && (h.open_newline == 0 || h.open_newline == '\n' || h.open_newline == '\r');
+		for (uptr i=1; i<checkpoints.size() && valid; ++i) {
+			valid = checkpoints[i] > checkpoints[i -1];
+		}
+		return valid;
+	}
+	void save_sidecar (cstr path, Sidecar_Header h) const { // failing to write (read-only dir) only means the next open scans again
+		memcpy(h.magic, LINE_INDEX_MAGIC, sizeof(h.magic));
+		h.line_count = (u64)line_count;
+		h.checkpoint_lines = CHECKPOINT_LINES;
+		h.text_len = text_len;
+		h.last_start = last_start;
+		h.open_newline = (u64)(u8)open_newline;
+		
+		auto f = fopen(path, "wb");
+		if (!f) return;
+		defer { fclose(f); };
+		
+		fwrite(&h, sizeof(h), 1, f);
+		fwrite(checkpoints.data(), sizeof(u64), checkpoints.size(), f);
+	}
+};
@@ -0,0 +1,244 @@
+
+// Lines of a buffer, in pages of around PAGE_LINES lines
+//  a page either holds its decoded lines, or is still mapped, then it only knows which range of lines of the mapped text it stands for,
+//  so a mapped file with hundreds of millions of lines costs one small page per PAGE_LINES lines, and only pages that get viewed or edited are ever decoded
+//  decoding is up to the owner, anything that needs a decoded page takes a load(Page*) callback
+//  mapped pages can be split, trimmed and dropped without decoding them, so deleting a huge range of a mapped file is cheap too
+//  references to lines stay valid until lines get inserted into or erased from their page (the vector of a page never moves when pages get inserted)
+template <typename LINE>
+struct Line_Pages {
+	typedef buf_indx_t indx_t;
+	
+	static const u32 PAGE_LINES = 256; // decoded pages get split once they grow past twice this, empty pages get dropped
+	
+	struct Page {
+		std::vector<LINE>	lines; // empty while the page is mapped
+		indx_t				mapped_first; // >= 0: page is mapped, it stands for the lines [mapped_first, mapped_first +count) of the mapped text
+		u32					count;
+		
+		bool is_mapped () const {	return mapped_first >= 0; }
+	};
+	std::vector<Page>		pages;
+	indx_t					count = 0;
+	
+	u32						cache_page = 0;
+	indx_t					cache_first = 0;
+	
+	std::vector<indx_t>		page_first; // first line of every page, for reading from worker threads, which can't move the cache, see update_page_first()
+	bool					page_first_valid = false;
+	
+	indx_t size () const { return count; }
+	
+	void clear () { // the lines are not released, the owner drops their whole pool
+		std::vector<Page>().swap(pages);
+		count = 0;
+		changed(0, 0);
+	}
+	void changed (u32 p, indx_t first) { // line counts of pages from p on changed, p starts at line first
+		if (p < (u32)pages.size()) {
+			cache_page = p;
+			cache_first = first;
+		} else {
+			cache_page = 0;
+			cache_first = 0;
+		}
+		page_first_valid = false;
+	}
+	
+	u32 find_page (indx_t l) { // page containing line l, l == line count maps to the last page, sets cache_first to the first line of that page
+		dbg_assert(pages.size() > 0);
+		while (l < cache_first) {
+			cache_page -= 1;
+			cache_first -= pages[cache_page].count;
+		}
+		while (cache_page +1 < (u32)pages.size() && l >= cache_first +pages[cache_page].count) {
+			cache_first += pages[cache_page].count;
+			cache_page += 1;
+		}
+		return cache_page;
+	}
+	
+	template <typename LOAD>
+	LINE& get (indx_t l, LOAD load) {
+		dbg_assert(l >= 0 && l < count);
+		auto& pg = pages[find_page(l)];
+		if (pg.is_mapped()) load(&pg);
+		return pg.lines[(uptr)(l -cache_first)];
+	}
+	
+	// reading on worker threads, while the main thread waits for them (the pages can't change in between)
+	void update_page_first () {
+		if (page_first_valid) return;
+		page_first.resize(pages.size());
+		indx_t first = 0;
+		for (uptr p=0; p<pages.size(); ++p) {
+			page_first[p] = first;
+			first += pages[p].count;
+		}
+		page_first_valid = true;
+	}
+	Page const& page_of (indx_t l, indx_t* i) const { // *i: index of line l in the page
+		dbg_assert(page_first_valid && l >= 0 && l < count);
+		uptr p = (uptr)(std::upper_bound(page_first.begin(), page_first.end(), l) -page_first.begin()) -1;
+		*i = l -page_first[p];
+		return pages[p];
+	}
+	bool mapped_range (indx_t l, indx_t n, indx_t* mapped_first) const { // are lines [l, l +n) all still mapped, and in one piece of the mapped text, *mapped_first: the mapped line of l
+		dbg_assert(page_first_valid && l >= 0 && n > 0 && l +n <= count);
+		uptr p = (uptr)(std::upper_bound(page_first.begin(), page_first.end(), l) -page_first.begin()) -1;
+		if (!pages[p].is_mapped()) return false;
+		
+		*mapped_first = pages[p].mapped_first +(l -page_first[p]);
+		for (indx_t next = page_first[p] +pages[p].count; next < l +n; next += pages[p].count) { // the pages after it need to continue it
+			indx_t mapped_next = pages[p].mapped_first +pages[p].count;
+			p += 1;
+			if (!pages[p].is_mapped() || pages[p].mapped_first != mapped_next) return false;
+		}
+		return true;
+	}
+	
+	// edits
+	void append_mapped (indx_t mapped_first, indx_t n) { // lines [mapped_first, mapped_first +n) of the mapped text after the last line
+		for (indx_t i=0; i<n; i+=PAGE_LINES) {
+			Page pg;
+			pg.mapped_first = mapped_first +i;
+			pg.count = (u32)min(n -i, (indx_t)PAGE_LINES);
+			pages.push_back(std::move(pg));
+		}
+		count += n;
+		page_first_valid = false;
+	}
+	
+	template <typename NEW_LINE>
+	static std::vector<Page> make_pages (indx_t n, NEW_LINE new_line) { // decoded pages of n empty lines, to decode into and then insert_pages()
+		std::vector<Page> new_pages;
+		for (indx_t i=0; i<n; i+=PAGE_LINES) {
+			Page pg;
+			pg.mapped_first = -1;
+			pg.count = (u32)min(n -i, (indx_t)PAGE_LINES);
+			pg.lines.reserve(pg.count);
+			for (u32 j=0; j<pg.count; ++j) pg.lines.push_back(new_line());
+			new_pages.push_back(std::move(pg));
+		}
+		return new_pages;
+	}
+	
+	u32 split_at (indx_t l) { // make line l the first line of a page, returns that page, pages.size() if l == line count
+		if (l == count) return (u32)pages.size();
+		u32 p = find_page(l);
+		u32 offs = (u32)(l -cache_first);
+		if (offs == 0) return p;
+		
+		auto& pg = pages[p];
+		Page tail;
+		tail.count = pg.count -offs;
+		if (pg.is_mapped()) {
+			tail.mapped_first = pg.mapped_first +offs;
+		} else {
+			tail.mapped_first = -1;
+			tail.lines.assign(std::make_move_iterator(pg.lines.begin() +offs), std::make_move_iterator(pg.lines.end()));
+			pg.lines.erase(pg.lines.begin() +offs, pg.lines.end());
+		}
+		pg.count = offs;
+		pages.insert(pages.begin() +p +1, std::move(tail));
+		
+		changed(p, cache_first);
+		return p +1;
+	}
+	
+	// insert before line l (l == line count appends), goes into the page of line l-1, which is usually decoded already (the cursor is on it)
+	template <typename LOAD>
+	void insert_pages (indx_t l, std::vector<Page>&& new_pages, LOAD load) {
+		if (new_pages.size() == 0) return;
+		indx_t n = 0;
+		for (auto& pg : new_pages) n += pg.count;
+		
+		if (pages.size() == 0) {
+			pages = std::move(new_pages);
+			changed(0, 0);
+		} else if (n <= PAGE_LINES) { // small inserts (enter, pasting a few lines) only grow a page
+			u32 p = find_page(max(l -1, (indx_t)0));
+			auto& pg = pages[p];
+			if (pg.is_mapped()) load(&pg);
+			
+			auto pos = pg.lines.begin() +(sptr)(l -cache_first);
+			for (auto& np : new_pages) {
+				pos = pg.lines.insert(pos, std::make_move_iterator(np.lines.begin()), std::make_move_iterator(np.lines.end()));
+				pos += np.count;
+			}
+			pg.count += (u32)n;
+			
+			if (pg.count > PAGE_LINES * 2) { // split into pages of PAGE_LINES, the remainder stays in the last one
+				std::vector<Page> split;
+				for (u32 b=PAGE_LINES; b +PAGE_LINES<=pg.count; b+=PAGE_LINES) {
+					u32 e = b +PAGE_LINES * 2 > pg.count ? pg.count : b +PAGE_LINES;
+					Page sp;
+					sp.mapped_first = -1;
+					sp.count = e -b;
+					sp.lines.assign(std::make_move_iterator(pg.lines.begin() +b), std::make_move_iterator(pg.lines.begin() +e));
+					split.push_back(std::move(sp));
+				}
+				pg.lines.erase(pg.lines.begin() +PAGE_LINES, pg.lines.end());
+				pg.count = PAGE_LINES;
+				pages.insert(pages.begin() +p +1, std::make_move_iterator(split.begin()), std::make_move_iterator(split.end()));
+			}
+			changed(p, cache_first);
+		} else {
+			u32 p = split_at(l);
+			indx_t first = l;
+			pages.insert(pages.begin() +p, std::make_move_iterator(new_pages.begin()), std::make_move_iterator(new_pages.end()));
+			changed(p, first);
+		}
+		count += n;
+	}
+	template <typename LOAD>
+	void insert (indx_t l, LINE&& line, LOAD load) {
+		std::vector<Page> pg(1);
+		pg[0].mapped_first = -1;
+		pg[0].count = 1;
+		pg[0].lines.push_back(std::move(line));
+		insert_pages(l, std::move(pg), load);
+	}
+	
+	void erase (indx_t l, indx_t n) { // erase lines [l, l +n), releases decoded ones, mapped ones are dropped without decoding them
+		if (n == 0) return;
+		dbg_assert(l >= 0 && l +n <= count);
+		u32 first_page = find_page(l);
+		indx_t first = cache_first;
+		
+		u32 p = first_page;
+		indx_t pg_first = first;
+		indx_t end = l +n;
+		while (p < (u32)pages.size() && pg_first < end) {
+			auto& pg = pages[p];
+			u32 b = (u32)(max(l, pg_first) -pg_first);
+			u32 e = (u32)(min(end, pg_first +(indx_t)pg.count) -pg_first);
+			pg_first += pg.count;
+			
+			if (pg.is_mapped()) {
+				if (b > 0 && e < pg.count) { // from the middle, split into two mapped pages
+					Page tail;
+					tail.mapped_first = pg.mapped_first +e;
+					tail.count = pg.count -e;
+					pg.count = b;
+					pages.insert(pages.begin() +p +1, std::move(tail));
+					break;
+				}
+				if (b == 0) pg.mapped_first += e;
+				pg.count -= e -b;
+			} else {
+				for (u32 i=b; i<e; ++i) pg.lines[i].release();
+				pg.lines.erase(pg.lines.begin() +b, pg.lines.begin() +e);
+				pg.count -= e -b;
+			}
+			p += 1;
+		}
+		count -= n;
+		
+		// drop pages that became empty, they are all in [first_page, p)
+		auto e = pages.begin() +min(p, (u32)pages.size());
+		pages.erase(std::remove_if(pages.begin() +first_page, e, [] (Page cr pg) { return pg.count == 0; }), e);
+		
+		changed(first_page, first);
+	}
+};
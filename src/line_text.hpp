@@ -0,0 +1,530 @@
+
+// rules that decide how many columns a char takes up (tab stops and visible newlines), the column index is only valid for the rules it was built with
+struct Col_Rules {
+	s32		tab_spaces;
+	bool	draw_whitespace;
+	
+	bool operator== (Col_Rules cr r) const { return tab_spaces == r.tab_spaces && draw_whitespace == r.draw_whitespace; }
+	bool operator!= (Col_Rules cr r) const { return !(*this == r); }
+};
+
+static buf_indx_t col_advance (buf_indx_t col, utf32 c, Col_Rules cr r) { // column after char c, if c starts at column col, needs to match what generate_layout() does
+	switch (c) {
+		case U'\t':					return col +(r.tab_spaces -(col % r.tab_spaces));
+		case U'\n': case U'\r':		return col +(r.draw_whitespace ? 1 : 0);
+		default:					return col +1;
+	}
+}
+
+// Allocator for the char data of one buffer, dropping the buffer frees everything at once with reset()
+//  blocks get carved from big slabs and recycled through free lists per power of two size class, so loading a file with millions of lines does not mean millions of mallocs
+//  blocks bigger than the biggest class come from malloc directly (only for a moment, when a huge paste goes into one chunk before it gets split)
+struct Text_Pool {
+	static const uptr	MIN_CLASS_SIZE =	32; // bytes
+	static const u32	CLASS_COUNT =		12; // biggest class is 64KB, more than a full chunk
+	static const uptr	SLAB_SIZE =			1024 * 1024;
+	
+	struct Free_Block {
+		Free_Block*	next;
+	};
+	Free_Block*			free_lists[CLASS_COUNT] = {};
+	
+	std::vector<byte*>	slabs;
+	byte*				slab_cur = nullptr;
+	byte*				slab_end = nullptr;
+	
+	std::vector<void*>	big_blocks; // from malloc, bigger than the biggest class
+	
+	Text_Pool () {}
+	Text_Pool (Text_Pool cr) = delete;
+	Text_Pool& operator= (Text_Pool cr) = delete;
+	~Text_Pool () {
+		reset();
+	}
+	
+	static u32 get_class (uptr size) { // smallest class that fits size, CLASS_COUNT if none does
+		u32 c = 0;
+		while (c < CLASS_COUNT && (MIN_CLASS_SIZE << c) < size) ++c;
+		return c;
+	}
+	
+	void* alloc (uptr size, uptr* capacity) { // capacity gets the usable size of the block
+		u32 c = get_class(size);
+		if (c == CLASS_COUNT) {
+			void* p = ::malloc(size);
+			big_blocks.push_back(p);
+			*capacity = size;
+			return p;
+		}
+		
+		uptr class_size = MIN_CLASS_SIZE << c;
+		*capacity = class_size;
+		
+		if (free_lists[c]) {
+			auto* b = free_lists[c];
+			free_lists[c] = b->next;
+			return b;
+		}
+		
+		if ((uptr)(slab_end -slab_cur) < class_size) { // the rest of the old slab stays unused until reset()
+			slab_cur = (byte*)::malloc(SLAB_SIZE);
+			slab_end = slab_cur +SLAB_SIZE;
+			slabs.push_back(slab_cur);
+		}
+		void* p = slab_cur;
+		slab_cur += class_size;
+		return p;
+	}
+	void free (void* p, uptr capacity) {
+		u32 c = get_class(capacity);
+		if (c == CLASS_COUNT) {
+			auto it = std::find(big_blocks.begin(), big_blocks.end(), p);
+			dbg_assert(it != big_blocks.end());
+			*it = big_blocks.back();
+			big_blocks.pop_back();
+			
+			::free(p);
+			return;
+		}
+		
+		auto* b = (Free_Block*)p;
+		b->next = free_lists[c];
+		free_lists[c] = b;
+	}
+	
+	void splice (Text_Pool* other) { // take over all memory of other (pools that were filled on other threads), arrays allocated from other now belong to this pool
+		slabs.insert(slabs.end(), other->slabs.begin(), other->slabs.end());
+		big_blocks.insert(big_blocks.end(), other->big_blocks.begin(), other->big_blocks.end());
+		
+		for (u32 c=0; c<CLASS_COUNT; ++c) {
+			if (!other->free_lists[c]) continue;
+			
+			auto* last = other->free_lists[c];
+			while (last->next) last = last->next;
+			last->next = free_lists[c];
+			free_lists[c] = other->free_lists[c];
+		}
+		
+		// the rest of other's current slab stays unused until reset()
+		other->slabs.clear();
+		other->big_blocks.clear();
+		other->slab_cur = nullptr;
+		other->slab_end = nullptr;
+		for (auto& f : other->free_lists) f = nullptr;
+	}
+	
+	void reset () { // frees everything, all arrays that were allocated from this pool are invalid after this
+		for (byte* slab : slabs)	::free(slab);
+		for (void* p : big_blocks)	::free(p);
+		slabs.clear();
+		big_blocks.clear();
+		
+		slab_cur = nullptr;
+		slab_end = nullptr;
+		for (auto& f : free_lists) f = nullptr;
+	}
+};
+
+// Growable array of trivially copyable T in a Text_Pool, arrays of up to INLINE_N elements are stored inline without any allocation
+//  has no destructor, so dropping a whole buffer is only a pool reset, arrays that get dropped before that need release()
+template <typename T, u32 INLINE_N>
+struct Pool_Array {
+	u32		count = 0;
+	u32		cap = INLINE_N; // > INLINE_N: elements are in heap
+	union {
+		T*	heap;
+		u64	inline_storage[(sizeof(T)*INLINE_N +7) / 8];
+	};
+	
+	bool is_inline () const {				return cap <= INLINE_N; }
+	
+	T* data () {							return is_inline() ? (T*)inline_storage : heap; }
+	T const* data () const {				return is_inline() ? (T const*)inline_storage : heap; }
+	u32 size () const {						return count; }
+	
+	T* begin () {							return data(); }
+	T* end () {								return data() +count; }
+	T const* begin () const {				return data(); }
+	T const* end () const {					return data() +count; }
+	
+	T& operator[] (u32 i) {					dbg_assert(i < count); return data()[i]; }
+	T const& operator[] (u32 i) const {		dbg_assert(i < count); return data()[i]; }
+	T& back () {							dbg_assert(count > 0); return data()[count -1]; }
+	T const& back () const {				dbg_assert(count > 0); return data()[count -1]; }
+	
+	void reserve (Text_Pool* pool, u32 n) {
+		if (n <= cap) return;
+		
+		uptr bytes;
+		T* p = (T*)pool->alloc((uptr)max(n, cap * 2) * sizeof(T), &bytes);
+		
+		if (count) memcpy((void*)p, data(), count * sizeof(T));
+		if (!is_inline()) pool->free(heap, (uptr)cap * sizeof(T));
+		
+		heap = p;
+		cap = (u32)(bytes / sizeof(T));
+	}
+	void release (Text_Pool* pool) {
+		if (!is_inline()) pool->free(heap, (uptr)cap * sizeof(T));
+		count = 0;
+		cap = INLINE_N;
+	}
+	void shrink (Text_Pool* pool) { // move back inline once the elements fit again, so arrays that got short again don't keep their pool block
+		if (is_inline() || count > INLINE_N) return;
+		
+		T* p = heap; // overlaps inline_storage
+		memcpy((void*)inline_storage, p, count * sizeof(T));
+		pool->free(p, (uptr)cap * sizeof(T));
+		cap = INLINE_N;
+	}
+	
+	T* insert_uninitialized (Text_Pool* pool, u32 i, u32 n) { // opens a gap of n elements at i
+		dbg_assert(i <= count);
+		reserve(pool, count +n);
+		
+		T* d = data();
+		memmove((void*)(d +i +n), d +i, (count -i) * sizeof(T));
+		count += n;
+		return d +i;
+	}
+	void insert (Text_Pool* pool, u32 i, T const* src, u32 n) { // src must not point into this array
+		if (n == 0) return;
+		memcpy((void*)insert_uninitialized(pool, i, n), src, n * sizeof(T));
+	}
+	void push_back (Text_Pool* pool, T cr val) {
+		reserve(pool, count +1);
+		data()[count++] = val;
+	}
+	
+	void erase (u32 b, u32 e) { // erase elements [b, e), keeps the storage
+		dbg_assert(b <= e && e <= count);
+		T* d = data();
+		memmove((void*)(d +b), d +e, (count -e) * sizeof(T));
+		count -= e -b;
+	}
+	void truncate (u32 n) { // keep the first n elements
+		dbg_assert(n <= count);
+		count = n;
+	}
+};
+
+// Char data of one line, split into chunks of at most CHUNK_MAX chars
+//  inserting or erasing only moves the chars of one chunk, so editing a multi-megabyte line (minified json etc.) is as fast as a short line
+//  almost all lines are shorter than CHUNK_MAX and so are just one chunk, which is stored inline, and lines of up to INLINE_CHARS chars don't allocate at all
+//  all storage comes from the Text_Pool of the buffer, there is no destructor, lines that get removed before the whole buffer is dropped need release()
+struct Line_Text {
+	typedef buf_indx_t indx_t;
+	
+	static const indx_t CHUNK_MAX = 4096;
+	static const uptr CHUNK_BYTES = 64; // one cache line
+	
+	// as many chars as fit into the chunk next to begin, col_begin and the count and cap of its array (10)
+	//  that covers about 30% of the lines of source code (blank lines, braces, short statements), measured with the newline on this repo and the libstdc++ headers,
+	//  but no lines of a typical log, 128 byte chunks (26 chars) would get code to about 50%, for 64 more bytes on every line
+	static const u32 INLINE_CHARS = (u32)((CHUNK_BYTES -2 * sizeof(indx_t) -2 * sizeof(u32)) / sizeof(utf32));
+	
+	struct Chunk {
+		Pool_Array<utf32, INLINE_CHARS>	text;
+		indx_t							begin;		// index of the first char of this chunk in the line
+		indx_t							col_begin;	// column of the first char of this chunk, only valid for chunks [0, cols_valid)
+	};
+	static_assert(sizeof(Chunk) == CHUNK_BYTES, "INLINE_CHARS does not fill the chunk");
+	
+	Text_Pool*				pool = nullptr;
+	Pool_Array<Chunk, 1>	chunks; // never contains empty chunks, an empty line has no chunks
+	indx_t					len = 0;
+	
+	// column index, built lazily up to the furthest chunk that was queried, edits invalidate all chunks after the edited one
+	u32						cols_valid = 0;
+	Col_Rules				cols_rules = {};
+	
+	Line_Text () {}
+	explicit Line_Text (Text_Pool* pool): pool{pool} {}
+	
+	// copying would alias the pool storage, moving swaps the contents, so the moved-from line now owns what the target owned (vector inserts and erases only ever move)
+	Line_Text (Line_Text cr) = delete;
+	Line_Text& operator= (Line_Text cr) = delete;
+	Line_Text (Line_Text&& r) noexcept: pool{r.pool} {
+		swap_contents(r);
+	}
+	Line_Text& operator= (Line_Text&& r) noexcept {
+		if (!pool) pool = r.pool;
+		dbg_assert(pool == r.pool); // lines can't move between buffers
+		swap_contents(r);
+		return *this;
+	}
+	void swap_contents (Line_Text& r) {
+		std::swap(chunks,		r.chunks);
+		std::swap(len,			r.len);
+		std::swap(cols_valid,	r.cols_valid);
+		std::swap(cols_rules,	r.cols_rules);
+	}
+	
+	void release () { // give all storage back to the pool, leaves an empty line
+		for (auto& ch : chunks) ch.text.release(pool);
+		chunks.release(pool);
+		len = 0;
+		cols_valid = 0;
+	}
+	
+	indx_t size () const {		return len; }
+	
+	u32 find_chunk (indx_t i) const { // chunk containing char i, i == len maps to the last chunk
+		dbg_assert(chunks.size() > 0 && i >= 0 && i <= len);
+		if (chunks.size() == 1) return 0;
+		
+		u32 lo = 0;
+		u32 hi = chunks.size();
+		while ((hi -lo) > 1) {
+			u32 mid = (lo +hi) / 2;
+			if (chunks[mid].begin <= i)	lo = mid;
+			else						hi = mid;
+		}
+		return lo;
+	}
+	
+	utf32 operator[] (indx_t i) const {
+		dbg_assert(i >= 0 && i < len);
+		auto& ch = chunks[ find_chunk(i) ];
+		return ch.text[ (u32)(i -ch.begin) ];
+	}
+	utf32 back () const {
+		dbg_assert(len > 0);
+		return chunks.back().text.back();
+	}
+	
+	template <typename FUNC>
+	void iterate (indx_t first, FUNC f) const { // calls f(indx_t i, utf32 c) for chars starting at first until f returns false
+		if (first >= len) return;
+		for (u32 k=find_chunk(first); k<chunks.size(); ++k) {
+			auto& ch = chunks[k];
+			utf32 const* text = ch.text.data();
+			for (indx_t j=max(first -ch.begin, (indx_t)0); j<(indx_t)ch.text.size(); ++j) {
+				if (!f(ch.begin +j, text[j])) return;
+			}
+		}
+	}
+	void copy_to (utf32* dst) const { // all size() chars
+		for (auto& ch : chunks) {
+			memcpy(dst, ch.text.data(), ch.text.size() * sizeof(utf32));
+			dst += ch.text.size();
+		}
+	}
+	
+	//
+	void _remove_chunk (u32 k) {
+		chunks[k].text.release(pool);
+		chunks.erase(k, k +1);
+	}
+	void _fixup (u32 k) { // remove empty chunks, split overfull chunks and recalc begin indices of chunks [k, chunks.size())
+		for (u32 j=k; j<chunks.size();) {
+			auto sz = (indx_t)chunks[j].text.size();
+			if (sz == 0) {
+				_remove_chunk(j);
+			} else if (sz > CHUNK_MAX) {
+				_split_chunk(j);
+			} else {
+				break; // only chunks that were just edited can be empty or overfull, and those are always at k
+			}
+		}
+		
+		indx_t begin = k > 0 ? chunks[k -1].begin +(indx_t)chunks[k -1].text.size() : 0;
+		for (u32 j=k; j<chunks.size(); ++j) {
+			chunks[j].begin = begin;
+			begin += (indx_t)chunks[j].text.size();
+		}
+		dbg_assert(begin == len);
+		
+		cols_valid = min(cols_valid, k);
+	}
+	void _split_chunk (u32 k) { // split into half full chunks, so that following inserts don't immediately split again
+		auto text = chunks[k].text; // take over the storage
+		chunks[k].text = decltype(text)();
+		
+		indx_t piece = CHUNK_MAX / 2;
+		indx_t count = ((indx_t)text.size() +piece -1) / piece;
+		
+		Chunk* added = chunks.insert_uninitialized(pool, k +1, (u32)(count -1));
+		for (indx_t j=0; j<count -1; ++j) added[j] = Chunk();
+		
+		for (indx_t j=0; j<count; ++j) {
+			indx_t b = j*piece;
+			indx_t e = min((j +1)*piece, (indx_t)text.size());
+			chunks[k +(u32)j].text.insert(pool, 0, text.data() +b, (u32)(e -b));
+		}
+		text.release(pool);
+	}
+	
+	void insert (indx_t i, utf32 const* data, indx_t n) {
+		dbg_assert(i >= 0 && i <= len);
+		if (n == 0) return;
+		
+		if (chunks.size() == 0) chunks.push_back(pool, Chunk());
+		
+		u32 k = find_chunk(i);
+		auto& ch = chunks[k];
+		ch.text.insert(pool, (u32)(i -ch.begin), data, (u32)n);
+		len += n;
+		
+		_fixup(k);
+	}
+	void insert (indx_t i, utf32 c) {
+		insert(i, &c, 1);
+	}
+	void push_back (utf32 c) {
+		insert(len, &c, 1);
+	}
+	
+	void erase (indx_t b, indx_t e) { // erase chars [b, e)
+		dbg_assert(b >= 0 && b <= e && e <= len);
+		if (b == e) return;
+		
+		u32 k = find_chunk(b);
+		
+		indx_t pos = b;
+		for (u32 j=k; pos < e; ++j) {
+			auto& ch = chunks[j];
+			indx_t lb = pos -ch.begin;
+			indx_t le = min(e -ch.begin, (indx_t)ch.text.size());
+			ch.text.erase((u32)lb, (u32)le);
+			ch.text.shrink(pool);
+			pos = ch.begin +le; // begin indices still refer to the unmodified text here
+		}
+		len -= e -b;
+		
+		// chunks fully covered by the erase are now empty
+		u32 kept = k;
+		for (u32 j=k; j<chunks.size(); ++j) {
+			if (chunks[j].text.size() == 0) {
+				chunks[j].text.release(pool);
+			} else {
+				chunks[kept++] = chunks[j];
+			}
+		}
+		chunks.truncate(kept);
+		_fixup(k);
+	}
+	void erase (indx_t i) {
+		erase(i, i +1);
+	}
+	
+	Line_Text split_off (indx_t i) { // remove chars [i, len) and return them, only moves whole chunks except for the one containing i
+		dbg_assert(i >= 0 && i <= len);
+		
+		Line_Text tail(pool);
+		if (i == len) return tail;
+		
+		u32 k = find_chunk(i);
+		auto& ch = chunks[k];
+		u32 split = (u32)(i -ch.begin);
+		
+		tail.chunks.push_back(pool, Chunk());
+		tail.chunks[0].text.insert(pool, 0, ch.text.data() +split, ch.text.size() -split);
+		ch.text.truncate(split);
+		ch.text.shrink(pool);
+		
+		tail.chunks.insert(pool, 1, chunks.data() +k +1, chunks.size() -(k +1)); // chunk structs move over with their storage
+		chunks.truncate(k +1);
+		
+		tail.len = len -i;
+		len = i;
+		
+		if (chunks[k].text.size() == 0) _remove_chunk(k);
+		_fixup(min(k, chunks.size()));
+		tail._fixup(0);
+		return tail;
+	}
+	void append (Line_Text&& r) { // move all chars of r to the end of this line
+		dbg_assert(pool == r.pool);
+		if (r.len == 0) {
+			r.release();
+			return;
+		}
+		
+		u32 k = chunks.size();
+		
+		u32 first = 0;
+		auto& first_text = r.chunks[0].text;
+		if (k > 0 && (indx_t)(chunks[k -1].text.size() +first_text.size()) <= CHUNK_MAX) {
+			// merge the touching chunks, else joining lines with backspace would leave lots of tiny chunks behind
+			--k;
+			chunks[k].text.insert(pool, chunks[k].text.size(), first_text.data(), first_text.size());
+			first_text.release(pool);
+			first = 1;
+		}
+		chunks.insert(pool, chunks.size(), r.chunks.data() +first, r.chunks.size() -first); // chunk structs move over with their storage
+		len += r.len;
+		
+		r.chunks.release(pool);
+		r.len = 0;
+		r.cols_valid = 0;
+		
+		_fixup(k);
+	}
+	
+	// column index
+	void _validate_cols (u32 k, Col_Rules cr r) { // make col_begin valid for chunks [0, k]
+		if (r != cols_rules) {
+			cols_rules = r;
+			cols_valid = 0;
+		}
+		if (cols_valid == 0) {
+			chunks[0].col_begin = 0;
+			cols_valid = 1;
+		}
+		for (; cols_valid <= k; ++cols_valid) {
+			auto& prev = chunks[cols_valid -1];
+			indx_t col = prev.col_begin;
+			for (utf32 c : prev.text) col = col_advance(col, c, r);
+			chunks[cols_valid].col_begin = col;
+		}
+	}
+	
+	indx_t get_col (indx_t i, Col_Rules cr r) { // column char i starts on
+		if (len == 0) return 0;
+		
+		u32 k = find_chunk(i);
+		_validate_cols(k, r);
+		
+		auto& ch = chunks[k];
+		utf32 const* text = ch.text.data();
+		indx_t col = ch.col_begin;
+		for (indx_t j=0; j<(i -ch.begin); ++j) col = col_advance(col, text[j], r);
+		return col;
+	}
+	indx_t find_col (indx_t col, Col_Rules cr r, indx_t* char_col) { // index of the char covering column col (len if col is past the end of the line), char_col gets the column that char starts on
+		if (len == 0) {
+			*char_col = 0;
+			return 0;
+		}
+		
+		_validate_cols(0, r);
+		while (cols_valid < chunks.size() && chunks[cols_valid -1].col_begin <= col) {
+			_validate_cols(cols_valid, r);
+		}
+		
+		u32 lo = 0;
+		u32 hi = cols_valid;
+		while ((hi -lo) > 1) {
+			u32 mid = (lo +hi) / 2;
+			if (chunks[mid].col_begin <= col)	lo = mid;
+			else								hi = mid;
+		}
+		
+		auto& ch = chunks[lo];
+		utf32 const* text = ch.text.data();
+		indx_t cur = ch.col_begin;
+		for (indx_t j=0; j<(indx_t)ch.text.size(); ++j) {
+			indx_t next = col_advance(cur, text[j], r);
+			if (next > col) {
+				*char_col = cur;
+				return ch.begin +j;
+			}
+			cur = next;
+		}
+		
+		dbg_assert(lo == chunks.size() -1); // col_begin of the next chunk would have been > col
+		*char_col = cur;
+		return len;
+	}
+};
@@ -0,0 +1,228 @@
+
+// os functionality the c/c++ std libs don't cover (file mapping, file timestamps, directory search, flushing files to disk, watching files for changes, unbuffered stdin)
+
+#if RZ_PLATF == RZ_PLATF_GENERIC_WIN
+	#include <io.h>
+	#include <fcntl.h>
+#elif RZ_PLATF == RZ_PLATF_GENERIC_UNIX
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+	#include <dirent.h>
+	#include <poll.h>
+	#include <sys/inotify.h>
+	#include <errno.h>
+#endif
+
+struct File_Watch { // wakes a thread when a file was written to
+	#if RZ_PLATF == RZ_PLATF_GENERIC_WIN
+	std::string	path; // ReadDirectoryChangesW only watches whole directories, so compare the stamp of the one file
+	u64			size;
+	u64			mtime;
+	#elif RZ_PLATF == RZ_PLATF_GENERIC_UNIX
+	int			fd = -1;
+	#endif
+};
+
+struct Mapped_File { // read-only mapping of a whole file, pages get loaded on first access
+	byte const*	data;
+	u64			size;
+	
+	#if RZ_PLATF == RZ_PLATF_GENERIC_WIN
+	HANDLE		file;
+	HANDLE		mapping;
+	#endif
+};
+
+#if RZ_PLATF == RZ_PLATF_GENERIC_WIN
+
+static bool map_file (cstr filename, Mapped_File* mf) {
+	mf->file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL); // others can keep writing to it (follow mode maps logs)
+	if (mf->file == INVALID_HANDLE_VALUE) return false;
+	
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(mf->file, &size) || size.QuadPart == 0) { // empty files can't be mapped
+		CloseHandle(mf->file);
+		return false;
+	}
+	mf->size = (u64)size.QuadPart;
+	
+	mf->mapping = CreateFileMappingA(mf->file, NULL, PAGE_READONLY, 0,0, NULL);
+	if (!mf->mapping) {
+		CloseHandle(mf->file);
+		return false;
+	}
+	
+	mf->data = (byte const*)MapViewOfFile(mf->mapping, FILE_MAP_READ, 0,0, 0);
+	if (!mf->data) {
+		CloseHandle(mf->mapping);
+		CloseHandle(mf->file);
+		return false;
+	}
+	return true;
+}
+static void unmap_file (Mapped_File* mf) {
+	UnmapViewOfFile(mf->data);
+	CloseHandle(mf->mapping);
+	CloseHandle(mf->file);
+	mf->data = nullptr;
+}
+
+static bool get_file_stamp (cstr filename, u64* size, u64* mtime) { // size and last write time, to detect changed files without reading them
+	WIN32_FILE_ATTRIBUTE_DATA d;
+	if (!GetFileAttributesExA(filename, GetFileExInfoStandard, &d)) return false;
+	
+	*size =		((u64)d.nFileSizeHigh << 32) | (u64)d.nFileSizeLow;
+	*mtime =	((u64)d.ftLastWriteTime.dwHighDateTime << 32) | (u64)d.ftLastWriteTime.dwLowDateTime;
+	return true;
+}
+
+static bool sync_file (FILE* f) { // flush the c buffers and wait until the os wrote the file to disk
+	if (fflush(f) != 0) return false;
+	return FlushFileBuffers((HANDLE)_get_osfhandle(_fileno(f))) != 0;
+}
+static bool truncate_file (FILE* f, u64 size) {
+	if (fflush(f) != 0) return false;
+	return _chsize_s(_fileno(f), (__int64)size) == 0;
+}
+
+static sptr read_stdin (void* buf, uptr size) { // blocks until anything is available, returns what is (fread would wait for all of size), 0 at the end, < 0 on error
+	_setmode(_fileno(stdin), _O_BINARY); // no \r\n translation
+	return (sptr)_read(_fileno(stdin), buf, (unsigned)min(size, (uptr)1 << 30));
+}
+
+static bool watch_file (cstr filename, File_Watch* w) {
+	w->path = filename;
+	return get_file_stamp(filename, &w->size, &w->mtime);
+}
+static void unwatch_file (File_Watch* w) {
+	w->path.clear();
+}
+static bool wait_file_changed (File_Watch* w, u32 timeout_ms) { // true if the file changed, false on timeout
+	for (u32 t=0;; t+=10) {
+		u64 size, mtime;
+		if (get_file_stamp(w->path.c_str(), &size, &mtime) && (size != w->size || mtime != w->mtime)) {
+			w->size = size;
+			w->mtime = mtime;
+			return true;
+		}
+		if (t >= timeout_ms) return false;
+		Sleep(10);
+	}
+}
+
+static bool find_file_in_dir_tree (cstr dir, cstr filename, std::string* path) { // dir needs a trailing slash, windows keeps fonts in one flat dir, so no recursion needed for now
+	auto p = prints("%s%s", dir, filename);
+	if (GetFileAttributesA(p.c_str()) == INVALID_FILE_ATTRIBUTES) return false;
+	
+	*path = p;
+	return true;
+}
+
+#elif RZ_PLATF == RZ_PLATF_GENERIC_UNIX
+
+static bool map_file (cstr filename, Mapped_File* mf) {
+	int fd = open(filename, O_RDONLY);
+	if (fd < 0) return false;
+	defer { close(fd); }; // the mapping stays valid after closing
+	
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0) return false; // empty files can't be mapped
+	mf->size = (u64)st.st_size;
+	
+	void* p = mmap(nullptr, (size_t)mf->size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (p == MAP_FAILED) return false;
+	
+	mf->data = (byte const*)p;
+	return true;
+}
+static void unmap_file (Mapped_File* mf) {
+	munmap((void*)mf->data, (size_t)mf->size);
+	mf->data = nullptr;
+}
+
+static bool get_file_stamp (cstr filename, u64* size, u64* mtime) { // size and last write time, to detect changed files without reading them
+	struct stat st;
+	if (stat(filename, &st) != 0) return false;
+	
+	*size =		(u64)st.st_size;
+	*mtime =	(u64)st.st_mtime;
+	return true;
+}
+
+static bool sync_file (FILE* f) { // flush the c buffers and wait until the os wrote the file to disk
+	if (fflush(f) != 0) return false;
+	return fsync(fileno(f)) == 0;
+}
+static bool truncate_file (FILE* f, u64 size) {
+	if (fflush(f) != 0) return false;
+	return ftruncate(fileno(f), (off_t)size) == 0;
+}
+
+static sptr read_stdin (void* buf, uptr size) { // blocks until anything is available, returns what is (fread would wait for all of size), 0 at the end, < 0 on error
+	for (;;) {
+		ssize_t n = read(STDIN_FILENO, buf, size);
+		if (n < 0 && errno == EINTR) continue;
+		return (sptr)n;
+	}
+}
+
+static bool watch_file (cstr filename, File_Watch* w) {
+	w->fd = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+	if (w->fd < 0) return false;
+	
+	if (inotify_add_watch(w->fd, filename, IN_MODIFY | IN_ATTRIB | IN_MOVE_SELF | IN_DELETE_SELF) < 0) {
+		close(w->fd);
+		w->fd = -1;
+		return false;
+	}
+	return true;
+}
+static void unwatch_file (File_Watch* w) {
+	if (w->fd >= 0) close(w->fd);
+	w->fd = -1;
+}
+static bool wait_file_changed (File_Watch* w, u32 timeout_ms) { // true if the file changed, false on timeout
+	pollfd p = { w->fd, POLLIN, 0 };
+	if (poll(&p, 1, (int)timeout_ms) <= 0) return false;
+	
+	// drain all queued events, a writer appending in small pieces causes a lot of them, and we only care that something changed
+	alignas(inotify_event) char buf[4096];
+	while (read(w->fd, buf, sizeof(buf)) > 0);
+	return true;
+}
+
+static bool find_file_in_dir_tree (cstr dir, cstr filename, std::string* path) { // dir needs a trailing slash, searches all subdirectories (fonts are usually sorted into subdirs per package)
+	DIR* d = opendir(dir);
+	if (!d) return false;
+	defer { closedir(d); };
+	
+	std::vector<std::string> subdirs;
+	
+	while (auto* e = readdir(d)) {
+		if (strcmp(e->d_name, ".") == 0 || strcmp(e->d_name, "..") == 0) continue;
+		
+		auto p = prints("%s%s", dir, e->d_name);
+		
+		bool is_dir = e->d_type == DT_DIR;
+		if (e->d_type == DT_UNKNOWN) { // some filesystems don't report the type
+			struct stat st;
+			is_dir = stat(p.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+		}
+		
+		if (is_dir) {
+			subdirs.push_back(p +"/");
+		} else if (strcmp(e->d_name, filename) == 0) {
+			*path = p;
+			return true;
+		}
+	}
+	
+	for (auto& sub : subdirs) {
+		if (find_file_in_dir_tree(sub.c_str(), filename, path)) return true;
+	}
+	return false;
+}
+
+#endif
@@ -0,0 +1,273 @@
+
+// Immutable copies of buffer contents for background work (search, save, syntax analysis) that reads while the user keeps editing
+//  a snapshot is a list of refcounted pages of up to PAGE_LINES lines, pages never change once built,
+//  so worker threads read them without any locks and the next snapshot shares all pages that had no edits since the last one
+//  taking a snapshot after typing a char only rebuilds the one page the char went into (+ copying the page pointers)
+//  lines of a mapped file that were not edited are not copied, their page is only the byte range of the mapping they are in,
+//  readers decode those pages themselves (Snapshot_Reader), so the first snapshot of a file of many GB costs one small page per PAGE_LINES lines
+
+// the bytes mapped lines get read from, shared by the buffer and the snapshots that have mapped pages,
+//  so a mapping that the buffer replaced (follow mode) or dropped stays mapped until the last snapshot of it is gone
+struct Mapped_Source {
+	Mapped_File					file = {};
+	utf8 const*					text = nullptr; // file without the bom, nullptr for a gzip file
+	#if CEDI_GZIP
+	std::unique_ptr<Gzip_Text>	gz; // the text is its output after gz_bom, file is the compressed file
+	u64							gz_bom = 0;
+	#endif
+	
+	~Mapped_Source () {
+		if (file.data) unmap_file(&file);
+	}
+	
+	utf8 const* read (u64 from, u64 to, std::vector<byte>* buf) const { // bytes [from, to) of the text, gzip output gets inflated into buf
+		#if CEDI_GZIP
+		if (gz) {
+			buf->resize((uptr)(to -from));
+			gz->read(gz_bom +from, gz_bom +to, buf->data());
+			return (utf8 const*)buf->data();
+		}
+		#endif
+		return text +from;
+	}
+};
+
+struct Snapshot_Page {
+	typedef buf_indx_t indx_t;
+	
+	std::vector<utf32>	chars; // of all lines in the page
+	std::vector<u32>	line_ends; // line i of the page is chars [line_ends[i-1], line_ends[i])
+	
+	// a mapped page has no chars, its lines are the count lines after the first skip lines of the bytes [from, to) of source
+	std::shared_ptr<Mapped_Source const>	source;
+	u64										from, to;
+	u32										skip;
+	u32										count;
+	
+	bool is_mapped () const {	return source != nullptr; }
+	
+	void decode (Snapshot_Page* out, std::vector<byte>* buf) const { // chars of a mapped page into out
+		auto* str = source->read(from, to, buf);
+		u64 b = skip_lines(str, to -from, 0, skip);
+		u64 e = skip_lines(str, to -from, b, count);
+		
+		out->chars.clear();
+		out->line_ends.assign(count, 0);
+		decode_utf8_lines(str +b, e -b, 0, [&] (indx_t i, utf32 c) {
+			out->chars.push_back(c);
+			out->line_ends[(uptr)i] = (u32)out->chars.size();
+		});
+		for (u32 i=1; i<count; ++i) out->line_ends[i] = max(out->line_ends[i], out->line_ends[i -1]); // only the last line of the text can be empty
+		out->count = count;
+	}
+};
+
+// decodes the mapped pages of one snapshot for one reader, it keeps the page of the last line it read, readers usually go through the lines in order
+struct Snapshot_Reader {
+	Snapshot_Page const*	page = nullptr; // the mapped page that got decoded
+	Snapshot_Page			decoded;
+	std::vector<byte>		bytes; // gzip output of the page
+};
+
+struct Buffer_Snapshot {
+	typedef buf_indx_t indx_t;
+	
+	u64													version; // of the buffer this was taken from, changes with every edit
+	indx_t												line_count;
+	std::vector<std::shared_ptr<Snapshot_Page const>>	pages;
+	std::vector<indx_t>									page_first; // first line of each page
+	
+	struct Line_View {
+		utf32 const*	text;
+		indx_t			len;
+	};
+	Line_View get_line (indx_t l, Snapshot_Reader* r) const { // the view stays valid until the next call with r
+		dbg_assert(l >= 0 && l < line_count);
+		u32 p = (u32)(std::upper_bound(page_first.begin(), page_first.end(), l) -page_first.begin()) -1;
+		
+		auto* pg = pages[p].get();
+		if (pg->is_mapped()) {
+			if (r->page != pg) {
+				pg->decode(&r->decoded, &r->bytes);
+				r->page = pg;
+			}
+			pg = &r->decoded;
+		}
+		u32 i = (u32)(l -page_first[p]);
+		u32 b = i ? pg->line_ends[i -1] : 0;
+		return { pg->chars.data() +b, (indx_t)(pg->line_ends[i] -b) };
+	}
+};
+
+// lives in the buffer and gets told about every edit, remembers which pages of the last snapshot are still valid
+struct Snapshot_Builder {
+	typedef buf_indx_t indx_t;
+	
+	static const u32 PAGE_LINES = 256; // pages get split when rebuilt with more than 2x this, and dropped when they become empty
+	
+	struct Page_Ref {
+		std::shared_ptr<Snapshot_Page const>	page; // null: lines of this page changed since the last snapshot
+		u32										count; // lines in the buffer that belong to this page
+	};
+	std::vector<Page_Ref>					pages;
+	
+	// edits are usually close to the last one, so finding the page of a line walks from the last found page
+	u32										cache_page = 0;
+	indx_t									cache_first = 0;
+	
+	u64										version = 0;
+	std::shared_ptr<Buffer_Snapshot const>	latest; // null if the buffer changed since it was taken
+	
+	void reset (indx_t line_count) { // all lines were replaced
+		pages.clear();
+		for (indx_t l=0; l<line_count; l+=PAGE_LINES) {
+			pages.push_back({ nullptr, (u32)min((indx_t)PAGE_LINES, line_count -l) });
+		}
+		cache_page = 0;
+		cache_first = 0;
+		changed();
+	}
+	
+	void changed () {
+		++version;
+		latest = nullptr;
+	}
+	
+	u32 find_page (indx_t l) { // page containing line l, l == line count maps to the last page, sets cache_first to the first line of that page
+		dbg_assert(pages.size() > 0);
+		while (l < cache_first) {
+			cache_page -= 1;
+			cache_first -= pages[cache_page].count;
+		}
+		while (cache_page +1 < (u32)pages.size() && l >= cache_first +pages[cache_page].count) {
+			cache_first += pages[cache_page].count;
+			cache_page += 1;
+		}
+		return cache_page;
+	}
+	
+	void line_changed (indx_t l) {
+		pages[find_page(l)].page = nullptr;
+		changed();
+	}
+	void line_inserted (indx_t l) { // new line at index l, the old line l and all after it moved down
+		lines_inserted(l, 1);
+	}
+	void lines_inserted (indx_t l, indx_t count) { // new lines [l, l +count), they all go into one page, get() splits it
+		if (count <= 0) return;
+		
+		auto& p = pages[find_page(l)];
+		p.page = nullptr;
+		p.count += (u32)count;
+		changed();
+	}
+	void line_erased (indx_t l) {
+		lines_erased(l, 1);
+	}
+	void lines_erased (indx_t l, indx_t count) { // lines [l, l +count)
+		if (count <= 0) return;
+		
+		u32 first = find_page(l);
+		indx_t offs = l -cache_first;
+		u32 end = first;
+		for (indx_t left=count; left>0; ++end) {
+			u32 n = (u32)min((indx_t)pages[end].count -offs, left);
+			pages[end].page = nullptr;
+			pages[end].count -= n;
+			left -= n;
+			offs = 0;
+		}
+		
+		auto empty = std::remove_if(pages.begin() +first, pages.begin() +end, [] (Page_Ref cr p) { return p.count == 0; });
+		if (empty != pages.begin() +end) {
+			pages.erase(empty, pages.begin() +end);
+			cache_page = 0; // cache_first of the pages after first would be wrong now
+			cache_first = 0;
+		}
+		dbg_assert(pages.size() > 0); // the buffer never has less than one line
+		changed();
+	}
+	void lines_appended (indx_t count) { // count new lines after the last one (appended to a growing file)
+		if (count <= 0) return;
+		
+		auto& last = pages.back();
+		u32 fill = (u32)min((indx_t)(PAGE_LINES -min(last.count, PAGE_LINES)), count);
+		if (fill) {
+			last.page = nullptr;
+			last.count += fill;
+		}
+		for (indx_t l=fill; l<count; l+=PAGE_LINES) {
+			pages.push_back({ nullptr, (u32)min((indx_t)PAGE_LINES, count -l) });
+		}
+		changed();
+	}
+	
+	//
+	template <typename APPEND_LINE>
+	static void build_page (Snapshot_Page* pg, indx_t first, u32 count, APPEND_LINE append_line) { // copies the chars of the lines
+		pg->line_ends.resize(count);
+		for (u32 i=0; i<count; ++i) {
+			append_line(first +i, &pg->chars);
+			pg->line_ends[i] = (u32)pg->chars.size();
+		}
+		pg->chars.shrink_to_fit();
+		pg->count = count;
+	}
+	
+	// snapshot of the current contents, only call from the thread that edits the buffer
+	//  build(Snapshot_Page* pg, indx_t first, u32 count) makes pg the page of lines [first, first +count), with build_page() or as a mapped page,
+	//  it gets called from worker threads (while the editing thread waits), but only for the pages that changed since the last snapshot
+	template <typename BUILD>
+	std::shared_ptr<Buffer_Snapshot const> get (indx_t line_count, BUILD build) {
+		if (latest) return latest;
+		
+		// split pages that grew too big, before building so that the new pages get built in parallel as well
+		//  one pass that copies the page list, a paste can put millions of lines into one page
+		bool split = false;
+		for (auto& p : pages) split = split || p.count > PAGE_LINES * 2;
+		if (split) {
+			std::vector<Page_Ref> split_pages;
+			for (auto& p : pages) {
+				u32 count = p.count;
+				if (count <= PAGE_LINES * 2) {
+					split_pages.push_back(std::move(p));
+					continue;
+				}
+				for (; count > PAGE_LINES * 2; count -= PAGE_LINES) split_pages.push_back({ nullptr, PAGE_LINES });
+				split_pages.push_back({ nullptr, count });
+			}
+			pages.swap(split_pages);
+		}
+		cache_page = 0;
+		cache_first = 0;
+		
+		auto* s = new Buffer_Snapshot;
+		s->version = version;
+		s->page_first.resize(pages.size());
+		
+		indx_t first = 0;
+		for (u32 i=0; i<(u32)pages.size(); ++i) {
+			s->page_first[i] = first;
+			first += pages[i].count;
+		}
+		s->line_count = first;
+		dbg_assert(s->line_count == line_count);
+		
+		// rebuild the pages with edits, this is all pages after a file was loaded (only the lines of a decoded file get copied, mapped ones are just looked up), so do it on all cores
+		g_jobs.parallel_for<u32>(0, (u32)pages.size(), 64, [&] (u32 b, u32 e) {
+			for (u32 i=b; i<e; ++i) {
+				if (pages[i].page) continue;
+				
+				auto* pg = new Snapshot_Page;
+				build(pg, s->page_first[i], pages[i].count);
+				pages[i].page = std::shared_ptr<Snapshot_Page const>(pg);
+			}
+		});
+		
+		s->pages.resize(pages.size());
+		for (u32 i=0; i<(u32)pages.size(); ++i) s->pages[i] = pages[i].page;
+		
+		latest = std::shared_ptr<Buffer_Snapshot const>(s);
+		return latest;
+	}
+};
@@ -0,0 +1,50 @@
+
+// Lock-free triple buffer to pass whole frames from one producer thread to one consumer thread
+//  the producer always has a slot to write into and never waits, the consumer always gets the latest completely written slot
+//  if the consumer is slower than the producer the frames in between get dropped
+template <typename T>
+struct Triple_Buffer {
+	static const u32 NEW_BIT = 4; // set in middle when the middle slot was published but not read yet
+	
+	T					slots[3];
+	
+	u32					back =		0; // only touched by the producer
+	u32					front =		1; // only touched by the consumer
+	std::atomic<u32>	middle {	2 };
+	
+	T& write_slot () {
+		return slots[back];
+	}
+	void publish () { // write_slot() is now owned by the consumer, the producer gets a new slot
+		back = middle.exchange(back | NEW_BIT, std::memory_order_acq_rel) & 3;
+	}
+	
+	bool has_new () const {
+		return (middle.load(std::memory_order_acquire) & NEW_BIT) != 0;
+	}
+	T* read_latest () { // nullptr if nothing was published since the last call
+		if (!has_new()) return nullptr;
+		front = middle.exchange(front, std::memory_order_acq_rel) & 3;
+		return &slots[front];
+	}
+};
+
+// wakes a waiting thread, only used for sleeping, data gets passed through lock-free structures
+struct Thread_Signal {
+	std::mutex				m;
+	std::condition_variable	cv;
+	bool					signaled = false;
+	
+	void signal () {
+		{
+			std::lock_guard<std::mutex> lck(m);
+			signaled = true;
+		}
+		cv.notify_one();
+	}
+	void wait () {
+		std::unique_lock<std::mutex> lck(m);
+		cv.wait(lck, [this] () { return signaled; });
+		signaled = false;
+	}
+};
@@ -34,36 +34,104 @@ static bool load_file (cstr filename, std::vector<byte>* data) {
 	return load_file_skip_bom(filename, data, nullptr, 0);
 }
 
-static utf32 utf8_to_utf32 (utf8 const** cur) {
+static u64 hash_fnv1a (void const* data, uptr size, u64 h=0xcbf29ce484222325) { // pass the previous hash as h to hash multiple pieces of data
+	auto* p = (u8 const*)data;
+	for (uptr i=0; i<size; ++i) {
+		h ^= p[i];
+		h *= 0x100000001b3;
+	}
+	return h;
+}
+
+static const utf32 UTF32_REPLACEMENT_CHAR = U'\xfffd';
+
+static utf32 utf8_to_utf32 (utf8 const** cur, utf8 const* end) { // malformed, overlong or cut off (by end) sequences decode to U+FFFD and only skip their first byte, so any bytes can be decoded
+	auto* p = (u8 const*)*cur;
+	
+	if ((p[0] & 0b10000000) == 0b00000000) {
+		*cur += 1;
+		return (utf32)p[0];
+	}
 	
-	if ((*(*cur) & 0b10000000) == 0b00000000) {
-		return (utf32)(u8)(*(*cur)++);
+	u32 len;
+	utf32 c;
+	utf32 min_c; // smaller codepoints would be overlong encodings
+	if (		(p[0] & 0b11100000) == 0b11000000) {	len = 2;	c = p[0] & 0b00011111;	min_c = 0x80; }
+	else if (	(p[0] & 0b11110000) == 0b11100000) {	len = 3;	c = p[0] & 0b00001111;	min_c = 0x800; }
+	else if (	(p[0] & 0b11111000) == 0b11110000) {	len = 4;	c = p[0] & 0b00000111;	min_c = 0x10000; }
+	else {
+		*cur += 1; // continuation byte without lead byte, or invalid lead byte
+		return UTF32_REPLACEMENT_CHAR;
 	}
-	if ((*(*cur) & 0b11100000) == 0b11000000) {
-		dbg_assert(((*cur)[1] & 0b11000000) == 0b10000000);
-		auto a = (utf32)(u8)(*(*cur)++ & 0b00011111);
-		auto b = (utf32)(u8)(*(*cur)++ & 0b00111111);
-		return a<<6|b;
+	
+	if ((uptr)(end -*cur) < len) {
+		*cur += 1;
+		return UTF32_REPLACEMENT_CHAR;
 	}
-	if ((*(*cur) & 0b11110000) == 0b11100000) {
-		dbg_assert(((*cur)[1] & 0b11000000) == 0b10000000);
-		dbg_assert(((*cur)[2] & 0b11000000) == 0b10000000);
-		auto a = (utf32)(u8)(*(*cur)++ & 0b00001111);
-		auto b = (utf32)(u8)(*(*cur)++ & 0b00111111);
-		auto c = (utf32)(u8)(*(*cur)++ & 0b00111111);
-		return a<<12|b<<6|c;
+	for (u32 i=1; i<len; ++i) {
+		if ((p[i] & 0b11000000) != 0b10000000) {
+			*cur += 1;
+			return UTF32_REPLACEMENT_CHAR;
+		}
+		c = c << 6 | (p[i] & 0b00111111);
 	}
-	if ((*(*cur) & 0b11111000) == 0b11110000) {
-		dbg_assert(((*cur)[1] & 0b11000000) == 0b10000000);
-		dbg_assert(((*cur)[2] & 0b11000000) == 0b10000000);
-		dbg_assert(((*cur)[3] & 0b11000000) == 0b10000000);
-		auto a = (utf32)(u8)(*(*cur)++ & 0b00000111);
-		auto b = (utf32)(u8)(*(*cur)++ & 0b00111111);
-		auto c = (utf32)(u8)(*(*cur)++ & 0b00111111);
-		auto d = (utf32)(u8)(*(*cur)++ & 0b00111111);
-		return a<<18|b<<12|c<<6|d;
+	if (c < min_c || c > 0x10ffff || (c >= 0xd800 && c <= 0xdfff)) { // surrogates can't be encoded in utf8
+		*cur += 1;
+		return UTF32_REPLACEMENT_CHAR;
 	}
-	dbg_assert(false);
 	
-	return (utf32)(u32)-1;
+	*cur += len;
+	return c;
+}
+
+static u32 utf32_to_utf8 (utf32 c, utf8* out) { // out needs room for 4 bytes, returns the number of bytes written
+	if (c < 0x80) {
+		out[0] = (utf8)c;
+		return 1;
+	}
+	if (c < 0x800) {
+		out[0] = (utf8)(0b11000000 | c >> 6);
+		out[1] = (utf8)(0b10000000 | (c & 0b00111111));
+		return 2;
+	}
+	if (c < 0x10000) {
+		out[0] = (utf8)(0b11100000 | c >> 12);
+		out[1] = (utf8)(0b10000000 | (c >> 6 & 0b00111111));
+		out[2] = (utf8)(0b10000000 | (c & 0b00111111));
+		return 3;
+	}
+	out[0] = (utf8)(0b11110000 | c >> 18);
+	out[1] = (utf8)(0b10000000 | (c >> 12 & 0b00111111));
+	out[2] = (utf8)(0b10000000 | (c >> 6 & 0b00111111));
+	out[3] = (utf8)(0b10000000 | (c & 0b00111111));
+	return 4;
+}
+
+static u64 complete_utf8_len (utf8 const* str, u64 len) { // len without a utf8 sequence at the end that is missing bytes (file is still being written)
+	for (u64 back=1; back<=min(len, (u64)4); ++back) {
+		u8 c = (u8)str[len -back];
+		if ((c & 0b11000000) == 0b10000000) continue; // continuation byte, lead byte is further back
+		
+		u64 seq_len = (c & 0b10000000) == 0 ? 1 : (c & 0b11100000) == 0b11000000 ? 2 : (c & 0b11110000) == 0b11100000 ? 3 : 4;
+		return seq_len > back ? len -back : len;
+	}
+	return len;
+}
+
+static const char HEX_DIGITS[] = "0123456789abcdef";
+
+static bool looks_binary (byte const* data, uptr len) { // only the heuristic for opening in the hex view: invalid utf8 (would decode to a lot of U+FFFD), or a lot of nul bytes (text files with a few of them still open as text)
+	uptr nuls = 0;
+	for (uptr i=0; i<len;) {
+		byte c = data[i];
+		if (c == 0) ++nuls;
+		
+		u32 seq_len = (c & 0b10000000) == 0 ? 1 : (c & 0b11100000) == 0b11000000 ? 2 : (c & 0b11110000) == 0b11100000 ? 3 : (c & 0b11111000) == 0b11110000 ? 4 : 0;
+		if (seq_len == 0) return true;
+		for (u32 j=1; j<seq_len && i +j < len; ++j) { // a sequence cut off by the end of data is fine
+			if ((data[i +j] & 0b11000000) != 0b10000000) return true;
+		}
+		i += seq_len;
+	}
+	return nuls > len / 32;
 }